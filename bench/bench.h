@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Helpers shared between the benchmarks.
+
+#include <stdlib.h>
+#include <time.h>
+
+/// Wall clock time in seconds.
+static inline double sf_bench_now() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/// A pseudo random float between min and max, from rand so runs are repeatable.
+static inline float random_float(const float min, const float max) {
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+#endif // BENCH_H
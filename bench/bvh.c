@@ -0,0 +1,124 @@
+// Bvh build, refit and query times against a linear sweep over every object's box.
+#include "sf/bvh.h"
+#include "bench.h"
+
+static sf_aabb random_box(const float extent) {
+    const sf_vec3 c = {random_float(-extent, extent), random_float(-extent, extent), random_float(-extent, extent)};
+    const float s = random_float(0.5f, 2.0f);
+    return (sf_aabb){{c.x - s, c.y - s, c.z - s}, {c.x + s, c.y + s, c.z + s}};
+}
+
+static bool box_visible(const sf_frustum *frustum, const sf_aabb *box) {
+    for (int i = 0; i < 6; ++i) {
+        const float *p = frustum->planes[i];
+        if (p[0] * (p[0] >= 0.0f ? box->max.x : box->min.x) + p[1] * (p[1] >= 0.0f ? box->max.y : box->min.y)
+            + p[2] * (p[2] >= 0.0f ? box->max.z : box->min.z) + p[3] < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+static void bench(const size_t count) {
+    // Keep the density of objects the same at every size.
+    const float extent = cbrtf((float)count) * 5.0f;
+    sf_aabb *boxes = sf_malloc(count * sizeof(sf_aabb));
+    sf_bvh_handle *handles = sf_malloc(count * sizeof(sf_bvh_handle));
+    for (size_t i = 0; i < count; ++i)
+        boxes[i] = random_box(extent);
+
+    sf_bvh bvh = sf_bvh_new(SF_BVH_MARGIN);
+    double start = sf_bench_now();
+    for (size_t i = 0; i < count; ++i)
+        handles[i] = sf_bvh_insert(&bvh, boxes[i], (uint32_t)i);
+    const double insert = sf_bench_now() - start;
+
+    start = sf_bench_now();
+    sf_bvh_build(&bvh, boxes, nullptr, count, handles);
+    const double build = sf_bench_now() - start;
+
+    // Every object drifts a little, the way most of a scene moves from one frame to the next.
+    for (size_t i = 0; i < count; ++i) {
+        const float dx = random_float(-0.05f, 0.05f), dy = random_float(-0.05f, 0.05f);
+        boxes[i].min.x += dx; boxes[i].max.x += dx;
+        boxes[i].min.y += dy; boxes[i].max.y += dy;
+    }
+    start = sf_bench_now();
+    for (size_t i = 0; i < count; ++i)
+        sf_bvh_update(&bvh, handles[i], boxes[i]);
+    sf_bvh_refit(&bvh);
+    const double refit = sf_bench_now() - start;
+
+    // A few objects teleport, which reinserts them.
+    const size_t moved = count / 100;
+    start = sf_bench_now();
+    for (size_t i = 0; i < moved; ++i) {
+        const size_t k = (size_t)rand() % count;
+        boxes[k] = random_box(extent);
+        sf_bvh_move(&bvh, handles[k], boxes[k]);
+    }
+    const double move = (sf_bench_now() - start) / (double)moved;
+
+    mat4 projection, view;
+    glm_perspective(glm_rad(70.0f), 16.0f / 9.0f, 0.1f, extent, projection);
+    glm_mat4_identity(view);
+    sf_frustum frustum;
+    sf_frustum_extract(&frustum, projection, view);
+
+    const size_t queries = 20;
+    sf_vec found = sf_vec_new(uint32_t);
+    size_t visible = 0;
+    start = sf_bench_now();
+    for (size_t q = 0; q < queries; ++q) {
+        found.count = 0;
+        visible = sf_bvh_query_frustum(&bvh, &frustum, &found);
+    }
+    const double query = (sf_bench_now() - start) / (double)queries;
+
+    size_t expected = 0;
+    start = sf_bench_now();
+    for (size_t q = 0; q < queries; ++q) {
+        expected = 0;
+        for (size_t i = 0; i < count; ++i)
+            expected += box_visible(&frustum, &boxes[i]);
+    }
+    const double sweep = (sf_bench_now() - start) / (double)queries;
+
+    const size_t rays = 10000;
+    size_t hits = 0, wrong = 0;
+    start = sf_bench_now();
+    for (size_t r = 0; r < rays; ++r) {
+        vec3 direction = {random_float(-1, 1), random_float(-1, 1), random_float(-1, 1)};
+        glm_vec3_normalize(direction);
+        const sf_ray ray = {{random_float(-extent, extent), random_float(-extent, extent), random_float(-extent, extent)}, {direction[0], direction[1], direction[2]}};
+        sf_bvh_hit hit;
+        hits += sf_bvh_raycast(&bvh, ray, extent, &hit);
+        // Check a few rays against every box.
+        if (r % 1000 == 0) {
+            const sf_vec3 inverse = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+            float best = extent, distance;
+            for (size_t i = 0; i < count; ++i)
+                if (sf_ray_aabb(ray, inverse, boxes[i], best, &distance) && distance < best)
+                    best = distance;
+            wrong += best != hit.distance;
+        }
+    }
+    const double raycast = (sf_bench_now() - start) / (double)rays;
+
+    printf("%8zu objects: insert %8.2f ms, build %8.2f ms, refit %6.2f ms, move %6.3f us, frustum %7.3f ms (sweep %7.3f ms, %5.1fx, %zu visible%s), ray %6.3f us (%zu hits%s)\n",
+        count, insert * 1e3, build * 1e3, refit * 1e3, move * 1e6,
+        query * 1e3, sweep * 1e3, sweep / query, visible, visible == expected ? "" : ", MISMATCH",
+        raycast * 1e6, hits, wrong ? ", MISMATCH" : "");
+
+    sf_vec_delete(&found);
+    sf_bvh_delete(&bvh);
+    free(boxes);
+    free(handles);
+}
+
+int main() {
+    srand(1);
+    bench(10000);
+    bench(100000);
+    bench(1000000);
+    return 0;
+}
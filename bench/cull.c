@@ -0,0 +1,56 @@
+// Frustum culling throughput: sf_frustum_cull against calling sf_frustum_test_sphere per sphere.
+#include "sf/bounds.h"
+#include "bench.h"
+
+static void bench(const sf_frustum *frustum, const size_t count) {
+    sf_sphere *spheres = sf_malloc(count * sizeof(sf_sphere));
+    uint32_t *expected = sf_malloc(count * sizeof(uint32_t));
+    uint32_t *visible = sf_malloc(count * sizeof(uint32_t));
+    for (size_t i = 0; i < count; ++i)
+        spheres[i] = (sf_sphere){{random_float(-500, 500), random_float(-500, 500), random_float(-500, 500)}, random_float(0.5f, 5)};
+
+    // Repeat small batches so every size tests roughly the same number of spheres.
+    const size_t rounds = 20000000 / count;
+
+    size_t scalar_count = 0;
+    double start = sf_bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+        scalar_count = 0;
+        for (size_t i = 0; i < count; ++i)
+            if (sf_frustum_test_sphere(frustum, spheres[i]))
+                expected[scalar_count++] = (uint32_t)i;
+    }
+    const double scalar = (sf_bench_now() - start) / (double)rounds;
+
+    size_t batched_count = 0;
+    start = sf_bench_now();
+    for (size_t r = 0; r < rounds; ++r)
+        batched_count = sf_frustum_cull(frustum, spheres, count, visible);
+    const double batched = (sf_bench_now() - start) / (double)rounds;
+
+    const bool same = scalar_count == batched_count && memcmp(expected, visible, scalar_count * sizeof(uint32_t)) == 0;
+    printf("%8zu spheres: sf_frustum_test_sphere %8.3f ms (%5.2f ns/s), sf_frustum_cull %8.3f ms (%5.2f ns/s), %5.2fx, %zu visible%s\n",
+        count,
+        scalar * 1e3, scalar * 1e9 / (double)count,
+        batched * 1e3, batched * 1e9 / (double)count,
+        scalar / batched, batched_count, same ? "" : ", MISMATCH");
+
+    free(spheres);
+    free(expected);
+    free(visible);
+}
+
+int main() {
+    srand(1);
+    mat4 projection, view;
+    glm_perspective(glm_rad(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f, projection);
+    glm_mat4_identity(view);
+    sf_frustum frustum;
+    sf_frustum_extract(&frustum, projection, view);
+
+    bench(&frustum, 1000);
+    bench(&frustum, 10000);
+    bench(&frustum, 100000);
+    bench(&frustum, 1000000);
+    return 0;
+}
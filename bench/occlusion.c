@@ -0,0 +1,137 @@
+// Occlusion culling: time to rasterize a wall with a doorway into the depth buffer, and to test boxes behind it.
+// Every culled box is checked by sampling points in it against the wall, so wrongly culled boxes are reported.
+#include "sf/occlusion.h"
+#include "bench.h"
+
+#define WALL_Z -20.0f
+#define WALL_CELLS 16
+
+/// The wall's panels, in x0, y0, x1, y1. The gap between them is the doorway.
+static const float panels[3][4] = {
+    {-40.0f, -20.0f, -2.0f, 20.0f},
+    {2.0f, -20.0f, 40.0f, 20.0f},
+    {-2.0f, 3.0f, 2.0f, 20.0f},
+};
+
+/// Split every panel into a grid of quads, the way a real occluder mesh would have more than two triangles.
+static size_t build_wall(sf_vertex *vertices, int32_t *indices) {
+    size_t v = 0, i = 0;
+    for (int p = 0; p < 3; ++p)
+        for (int y = 0; y <= WALL_CELLS; ++y)
+            for (int x = 0; x <= WALL_CELLS; ++x) {
+                const float fx = (float)x / WALL_CELLS, fy = (float)y / WALL_CELLS;
+                vertices[v] = (sf_vertex){ .position = {panels[p][0] + (panels[p][2] - panels[p][0]) * fx, panels[p][1] + (panels[p][3] - panels[p][1]) * fy, WALL_Z} };
+                if (x < WALL_CELLS && y < WALL_CELLS) {
+                    const int32_t a = (int32_t)v, b = a + 1, c = a + WALL_CELLS + 1, d = c + 1;
+                    const int32_t quad[6] = {a, b, d, a, d, c};
+                    memcpy(indices + i, quad, sizeof(quad));
+                    i += 6;
+                }
+                v++;
+            }
+    return i;
+}
+
+/// Whether a point is inside the view.
+static bool in_view(const float x, const float y, const float z) {
+    const float half_height = tanf(glm_rad(35.0f)) * -z;
+    return z < 0.0f && fabsf(y) <= half_height && fabsf(x) <= half_height * 2.0f;
+}
+
+/// Whether a point is hidden from the origin by the wall.
+static bool behind_wall(const float x, const float y, const float z) {
+    if (z > WALL_Z)
+        return false;
+    const float s = WALL_Z / z, px = x * s, py = y * s;
+    for (int p = 0; p < 3; ++p)
+        if (px >= panels[p][0] && px <= panels[p][2] && py >= panels[p][1] && py <= panels[p][3])
+            return true;
+    return false;
+}
+
+/// Sample points all over a box: it's visible if any of them is in view and not behind the wall.
+/// Returns whether it's visible, and sets hidden if it's in view but entirely behind the wall.
+static bool box_visible(const sf_aabb box, bool *hidden) {
+    bool seen = false;
+    for (int i = 0; i <= 4; ++i)
+        for (int j = 0; j <= 4; ++j)
+            for (int k = 0; k <= 4; ++k) {
+                const float x = box.min.x + (box.max.x - box.min.x) * (float)i / 4.0f;
+                const float y = box.min.y + (box.max.y - box.min.y) * (float)j / 4.0f;
+                const float z = box.min.z + (box.max.z - box.min.z) * (float)k / 4.0f;
+                if (!in_view(x, y, z))
+                    continue;
+                if (!behind_wall(x, y, z))
+                    return true;
+                seen = true;
+            }
+    *hidden = seen;
+    return false;
+}
+
+static void bench(sf_camera *camera, const sf_vertex *vertices, const int32_t *indices, const size_t index_count,
+    const sf_aabb *boxes, const size_t count, const sf_vec2 size) {
+    sf_occlusion occlusion = sf_occlusion_new(size);
+    mat4 model;
+    glm_mat4_identity(model);
+
+    const size_t rounds = 200;
+    double start = sf_bench_now();
+    for (size_t r = 0; r < rounds; ++r) {
+        sf_occlusion_begin(&occlusion, camera);
+        sf_occlusion_add_triangles(&occlusion, vertices, indices, index_count, model);
+        sf_occlusion_finish(&occlusion);
+    }
+    const double raster = (sf_bench_now() - start) / (double)rounds;
+
+    size_t wrong = 0;
+    bool *visible = sf_malloc(count * sizeof(bool));
+    start = sf_bench_now();
+    for (size_t i = 0; i < count; ++i)
+        visible[i] = sf_occlusion_test(&occlusion, boxes[i]);
+    const double test = sf_bench_now() - start;
+    size_t hidden = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool behind = false;
+        if (box_visible(boxes[i], &behind))
+            wrong += !visible[i];
+        hidden += behind;
+    }
+
+    printf("%4ux%-4u buffer: %zu occluder triangles in %6.3f ms, %zu boxes tested in %6.3f ms (%5.1f ns/box), %zu culled of %zu behind the wall%s\n",
+        occlusion.width, occlusion.height, occlusion.stats.occluder_triangles, raster * 1e3,
+        occlusion.stats.tested, test * 1e3, test * 1e9 / (double)count,
+        occlusion.stats.culled, hidden, wrong ? ", WRONGLY CULLED" : "");
+    if (wrong)
+        printf("    %zu visible boxes were culled\n", wrong);
+
+    free(visible);
+    sf_occlusion_delete(&occlusion);
+}
+
+int main() {
+    srand(1);
+    sf_camera camera = sf_camera_new(SF_CAMERA_PERSPECTIVE, glm_rad(70.0f), 0.1f, 200.0f);
+    glm_perspective(camera.fov, 2.0f, camera.near, camera.far, camera.projection);
+
+    sf_vertex *vertices = sf_malloc(3 * (WALL_CELLS + 1) * (WALL_CELLS + 1) * sizeof(sf_vertex));
+    int32_t *indices = sf_malloc(3 * WALL_CELLS * WALL_CELLS * 6 * sizeof(int32_t));
+    const size_t index_count = build_wall(vertices, indices);
+
+    const size_t count = 100000;
+    sf_aabb *boxes = sf_malloc(count * sizeof(sf_aabb));
+    for (size_t i = 0; i < count; ++i) {
+        const sf_vec3 c = {random_float(-60, 60), random_float(-30, 30), random_float(-100, -1)};
+        const float s = random_float(0.25f, 2.0f);
+        boxes[i] = (sf_aabb){{c.x - s, c.y - s, c.z - s}, {c.x + s, c.y + s, c.z + s}};
+    }
+
+    bench(&camera, vertices, indices, index_count, boxes, count, (sf_vec2){128, 64});
+    bench(&camera, vertices, indices, index_count, boxes, count, (sf_vec2){256, 128});
+    bench(&camera, vertices, indices, index_count, boxes, count, (sf_vec2){512, 256});
+
+    free(boxes);
+    free(vertices);
+    free(indices);
+    return 0;
+}
@@ -0,0 +1,53 @@
+// Transform to matrix throughput: sf_transform_models against calling sf_transform_model per transform.
+#include "sf/transforms.h"
+#include "bench.h"
+
+static void bench(const size_t count) {
+    sf_transform *transforms = sf_malloc(count * sizeof(sf_transform));
+    mat4 *expected = sf_malloc(count * sizeof(mat4));
+    mat4 *models = sf_malloc(count * sizeof(mat4));
+    for (size_t i = 0; i < count; ++i)
+        transforms[i] = (sf_transform){
+            .position = {random_float(-100, 100), random_float(-100, 100), random_float(-100, 100)},
+            .rotation = {random_float(0, 360), random_float(0, 360), random_float(0, 360)},
+            .scale = {random_float(0.5f, 2), random_float(0.5f, 2), random_float(0.5f, 2)},
+        };
+
+    // Repeat small batches so every size converts roughly the same number of transforms.
+    const size_t rounds = 2000000 / count;
+
+    double start = sf_bench_now();
+    for (size_t r = 0; r < rounds; ++r)
+        for (size_t i = 0; i < count; ++i)
+            sf_transform_model(expected[i], transforms[i]);
+    const double scalar = (sf_bench_now() - start) / (double)rounds;
+
+    start = sf_bench_now();
+    for (size_t r = 0; r < rounds; ++r)
+        sf_transform_models(models, transforms, count);
+    const double batched = (sf_bench_now() - start) / (double)rounds;
+
+    float error = 0;
+    for (size_t i = 0; i < count; ++i)
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                error = fmaxf(error, fabsf(models[i][c][r] - expected[i][c][r]));
+
+    printf("%7zu transforms: sf_transform_model %8.3f ms (%6.2f ns/t), sf_transform_models %8.3f ms (%6.2f ns/t), %5.2fx, max error %g\n",
+        count,
+        scalar * 1e3, scalar * 1e9 / (double)count,
+        batched * 1e3, batched * 1e9 / (double)count,
+        scalar / batched, (double)error);
+
+    free(transforms);
+    free(expected);
+    free(models);
+}
+
+int main() {
+    srand(1);
+    bench(1000);
+    bench(10000);
+    bench(100000);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Vertex welding throughput: sf_mesh_add_vertices against the previous sf_map based dedup.
+// Builds a triangle soup over a grid, so every unique vertex appears ~6 times.
+#include "sf/meshes.h"
+#include "bench.h"
+
+#define GRID 408 // 408 * 408 * 6 ~= 1M vertices
+
+static sf_vertex grid_vertex(const int x, const int y) {
+    return (sf_vertex){
+        {(float)x, 0.0f, (float)y},
+        {(float)x / GRID, (float)y / GRID},
+        sf_rgbagl(SF_WHITE),
+    };
+}
+
+/// The dedup path sf_mesh used before the vertex table, kept here as the baseline.
+static void map_weld(sf_map *cache, sf_vec *vertices, sf_vec *indices, const sf_vertex *input, const size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const sf_map_key key = (sf_map_key){(uint8_t *)&input[i], sizeof(sf_vertex)};
+        if (sf_map_exists(cache, key)) {
+            sf_vec_push(indices, sf_map_get(cache, key));
+            continue;
+        }
+        sf_vec_push(vertices, &input[i]);
+        sf_vec_push(indices, &(int32_t){(int32_t)vertices->count - 1});
+        sf_map_insert(cache, key, &(int32_t){(int32_t)vertices->count - 1}, sizeof(int32_t));
+    }
+}
+
+int main() {
+    const size_t count = (size_t)GRID * GRID * 6;
+    sf_vertex *input = sf_malloc(count * sizeof(sf_vertex));
+    size_t n = 0;
+    for (int y = 0; y < GRID; ++y) {
+        for (int x = 0; x < GRID; ++x) {
+            input[n++] = grid_vertex(x, y);
+            input[n++] = grid_vertex(x + 1, y);
+            input[n++] = grid_vertex(x, y + 1);
+            input[n++] = grid_vertex(x + 1, y);
+            input[n++] = grid_vertex(x + 1, y + 1);
+            input[n++] = grid_vertex(x, y + 1);
+        }
+    }
+
+    // Meshes are built by hand so no OpenGL context is needed, welding never touches the gpu.
+    sf_mesh mesh = {
+        .vertices = sf_vec_new(sf_vertex),
+        .indices = sf_vec_new(int32_t),
+    };
+    double start = sf_bench_now();
+    sf_mesh_add_vertices(&mesh, input, count);
+    const double table_time = sf_bench_now() - start;
+    const size_t table_unique = mesh.vertices.count;
+
+    sf_map cache = sf_map_new();
+    sf_vec vertices = sf_vec_new(sf_vertex), indices = sf_vec_new(int32_t);
+    start = sf_bench_now();
+    map_weld(&cache, &vertices, &indices, input, count);
+    const double map_time = sf_bench_now() - start;
+
+    printf("welded %zu vertices into %zu (sf_map: %zu)\n", count, table_unique, vertices.count);
+    printf("sf_vertex_table: %8.2f ms, %8.2f Mvert/s\n", table_time * 1e3, (double)count / table_time * 1e-6);
+    printf("sf_map:          %8.2f ms, %8.2f Mvert/s\n", map_time * 1e3, (double)count / map_time * 1e-6);
+    printf("speedup:         %8.2fx\n", map_time / table_time);
+
+    sf_vec_delete(&mesh.vertices);
+    sf_vec_delete(&mesh.indices);
+    free(mesh.cache.slots);
+    sf_map_delete(&cache);
+    sf_vec_delete(&vertices);
+    sf_vec_delete(&indices);
+    free(input);
+    return 0;
+}
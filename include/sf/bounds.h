@@ -0,0 +1,88 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <sf/numerics.h>
+#include <cglm/cglm.h>
+#include "export.h"
+#include "sf/vertices.h"
+
+/// An axis aligned bounding box.
+typedef struct {
+    sf_vec3 min, max;
+} sf_aabb;
+
+/// A bounding sphere, four floats so batches of them load straight into SIMD registers.
+typedef struct {
+    sf_vec3 center;
+    float radius;
+} sf_sphere;
+
+/// The bounds of a set of vertices.
+typedef struct {
+    sf_aabb box;
+    sf_sphere sphere;
+} sf_bounds;
+
+/// A ray starting at origin, reaching origin + direction * t for t >= 0.
+typedef struct {
+    sf_vec3 origin, direction;
+} sf_ray;
+
+/// The planes of a view volume, facing inwards: a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+/// Ordered left, right, bottom, top, near, far.
+typedef struct {
+    vec4 planes[6];
+} sf_frustum;
+
+/// Compute the box around some vertices, and a sphere around the box's center enclosing all of them.
+EXPORT sf_bounds sf_bounds_compute(const sf_vertex *vertices, size_t count);
+/// Get the box around a box after a model matrix moves it into its space.
+EXPORT sf_aabb sf_aabb_transform(sf_aabb box, const mat4 model);
+/// Get the smallest box containing both boxes.
+static inline sf_aabb sf_aabb_union(const sf_aabb a, const sf_aabb b) {
+    return (sf_aabb){
+        {fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z)},
+        {fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z)},
+    };
+}
+/// Whether box a contains all of box b.
+static inline bool sf_aabb_contains(const sf_aabb a, const sf_aabb b) {
+    return a.min.x <= b.min.x && a.min.y <= b.min.y && a.min.z <= b.min.z
+        && a.max.x >= b.max.x && a.max.y >= b.max.y && a.max.z >= b.max.z;
+}
+/// Surface area of a box.
+static inline float sf_aabb_area(const sf_aabb box) {
+    const float x = box.max.x - box.min.x, y = box.max.y - box.min.y, z = box.max.z - box.min.z;
+    return 2.0f * (x * y + y * z + z * x);
+}
+/// Where a ray enters a box, given the reciprocal of its direction. Returns false if it misses,
+/// or only reaches the box past max_distance. Rays starting inside the box enter it at 0.
+static inline bool sf_ray_aabb(const sf_ray ray, const sf_vec3 inverse, const sf_aabb box, const float max_distance, float *distance) {
+    const float x0 = (box.min.x - ray.origin.x) * inverse.x, x1 = (box.max.x - ray.origin.x) * inverse.x;
+    const float y0 = (box.min.y - ray.origin.y) * inverse.y, y1 = (box.max.y - ray.origin.y) * inverse.y;
+    const float z0 = (box.min.z - ray.origin.z) * inverse.z, z1 = (box.max.z - ray.origin.z) * inverse.z;
+    const float near = fmaxf(fmaxf(fminf(x0, x1), fminf(y0, y1)), fmaxf(fminf(z0, z1), 0.0f));
+    const float far = fminf(fminf(fmaxf(x0, x1), fmaxf(y0, y1)), fminf(fmaxf(z0, z1), max_distance));
+    *distance = near;
+    return near <= far;
+}
+/// Move a sphere into the space of a model matrix. The radius grows with the matrix's largest axis scale.
+EXPORT sf_sphere sf_sphere_transform(sf_sphere sphere, const mat4 model);
+
+/// Extract the planes of the view volume seen through a projection and view matrix, in world space.
+EXPORT void sf_frustum_extract(sf_frustum *out, const mat4 projection, const mat4 view);
+/// Whether any part of a world space sphere may be inside a frustum.
+static inline bool sf_frustum_test_sphere(const sf_frustum *frustum, const sf_sphere sphere) {
+    for (int i = 0; i < 6; ++i) {
+        const float *p = frustum->planes[i];
+        if (p[0] * sphere.center.x + p[1] * sphere.center.y + p[2] * sphere.center.z + p[3] < -sphere.radius)
+            return false;
+    }
+    return true;
+}
+/// Test count world space spheres against a frustum, writing the index of every visible one to visible.
+/// Uses SSE to test several spheres at once, or AVX2 on cpus that have it when built with SF_ENABLE_AVX2.
+/// Returns the number of visible spheres, visible must have room for count of them.
+EXPORT size_t sf_frustum_cull(const sf_frustum *frustum, const sf_sphere *spheres, size_t count, uint32_t *visible);
+
+#endif // BOUNDS_H
@@ -0,0 +1,77 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <sf/dynamic.h>
+#include "sf/bounds.h"
+#include "sf/meshes.h"
+
+/// Handle to an object in a bvh. Handles stay valid until the object is removed, even across rebalancing.
+typedef int32_t sf_bvh_handle;
+/// A handle that refers to nothing.
+#define SF_BVH_NONE (sf_bvh_handle)-1
+/// Default distance leaf boxes are fattened by, so objects can move a little before they're reinserted.
+#define SF_BVH_MARGIN 0.1f
+
+/// A node of a bvh. Leaves hold one object each and have no children.
+typedef struct {
+    sf_aabb box; /// Fattened box of a leaf, or the union of both children's boxes.
+    sf_aabb object; /// The object's exact box, only set for leaves.
+    int32_t parent; /// Next free node while the node is unused.
+    int32_t left, right; /// SF_BVH_NONE for leaves.
+    int32_t height; /// 0 for leaves, -1 while the node is unused.
+    uint32_t user; /// Caller data of a leaf's object, reported by queries.
+} sf_bvh_node;
+
+/// A dynamic bounding volume hierarchy over axis aligned boxes, for culling and picking in large scenes.
+/// Objects are inserted where they grow the tree's surface area the least, and the tree is kept balanced
+/// with rotations, so every operation is O(log objects).
+typedef struct {
+    sf_bvh_node *nodes;
+    size_t capacity, count; /// Number of nodes allocated and objects in the tree.
+    int32_t root, free_node;
+    float margin;
+    int32_t *stack; /// Scratch space for traversals.
+    size_t stack_capacity;
+} sf_bvh;
+
+/// A hit of a ray cast into a bvh.
+typedef struct {
+    sf_bvh_handle handle;
+    uint32_t user;
+    float distance; /// Distance along the ray, in multiples of its direction.
+} sf_bvh_hit;
+
+/// Create an empty bvh, leaf boxes are fattened by margin on every side.
+[[nodiscard]] EXPORT sf_bvh sf_bvh_new(float margin);
+/// Free a bvh and all of its nodes.
+EXPORT void sf_bvh_delete(sf_bvh *bvh);
+
+/// Replace everything in a bvh with count objects at once, writing their handles to out.
+/// Splits at the median of the longest axis top down, much faster than inserting one at a time.
+EXPORT void sf_bvh_build(sf_bvh *bvh, const sf_aabb *boxes, const uint32_t *users, size_t count, sf_bvh_handle *out);
+/// Add an object with a box and caller data.
+EXPORT sf_bvh_handle sf_bvh_insert(sf_bvh *bvh, sf_aabb box, uint32_t user);
+/// Remove an object from the tree.
+EXPORT void sf_bvh_remove(sf_bvh *bvh, sf_bvh_handle handle);
+/// Give an object a new box. It's only reinserted if the box left the fattened one.
+/// Returns whether the tree changed.
+EXPORT bool sf_bvh_move(sf_bvh *bvh, sf_bvh_handle handle, sf_aabb box);
+/// Overwrite an object's box without touching the tree, call sf_bvh_refit afterwards.
+/// Cheaper than moving when most objects move every frame, but the tree gets looser until it's rebuilt.
+EXPORT void sf_bvh_update(sf_bvh *bvh, sf_bvh_handle handle, sf_aabb box);
+/// Recompute every parent's box from its children, bottom up.
+EXPORT void sf_bvh_refit(sf_bvh *bvh);
+/// Get the caller data of an object.
+static inline uint32_t sf_bvh_user(const sf_bvh *bvh, const sf_bvh_handle handle) { return bvh->nodes[handle].user; }
+
+/// Push the caller data of every object whose box may be inside a frustum to out, an sf_vec of uint32_t.
+/// Returns the number of objects found.
+EXPORT size_t sf_bvh_query_frustum(sf_bvh *bvh, const sf_frustum *frustum, sf_vec *out);
+/// Find the nearest object whose box a ray hits within max_distance.
+/// Returns false if it misses everything.
+EXPORT bool sf_bvh_raycast(sf_bvh *bvh, sf_ray ray, float max_distance, sf_bvh_hit *hit);
+
+/// Box of a mesh placed in the world by a model matrix, such as a world matrix from an sf_transform_tree.
+static inline sf_aabb sf_mesh_world_box(const sf_mesh *mesh, const mat4 model) { return sf_aabb_transform(mesh->bounds.box, model); }
+
+#endif // BVH_H
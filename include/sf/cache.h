@@ -0,0 +1,65 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <sf/dynamic.h>
+#include <sf/result.h>
+#include "export.h"
+#include "sf/textures.h"
+
+/// Bytes of vram a texture cache keeps unreferenced textures around in when given no budget.
+#define SF_TEXTURE_CACHE_BUDGET (256 * 1024 * 1024)
+
+/// A texture shared through a cache. Hold on to the pointer, it stays valid until the last reference is released.
+typedef struct {
+    sf_texture texture;
+    uint64_t content_hash; /// Hash of the file's contents.
+    size_t file_size;
+    size_t bytes; /// Vram the texture takes up, see sf_texture_bytes.
+    uint32_t refs;
+    uint64_t used; /// Cache tick the texture was last handed out on.
+} sf_cached_texture;
+
+/// One canonical path that resolves to a cached texture, several paths can share one when their files are identical.
+typedef struct {
+    sf_str path;
+    uint64_t hash;
+    sf_cached_texture *texture;
+} sf_cached_path;
+
+typedef struct {
+    uint64_t hits, misses, evictions;
+    size_t resident; /// Bytes of vram used by every cached texture, referenced or not.
+} sf_texture_cache_stats;
+
+/// Loads every texture file once, no matter how many times or through which paths it's asked for.
+/// Files are found by their canonical path first, then by a hash of their contents so copies of a file share a texture.
+/// Textures nobody references are kept until the cache is over its vram budget, then evicted least recently used first.
+/// Referenced textures are never evicted, so the cache can go over its budget while they're alive.
+typedef struct {
+    sf_vec textures; /// sf_cached_texture *
+    sf_vec paths; /// sf_cached_path
+    size_t budget;
+    uint64_t tick;
+    sf_texture_cache_stats stats;
+} sf_texture_cache;
+
+/// Create an empty texture cache that keeps up to budget bytes of vram resident, 0 for the default.
+[[nodiscard]] EXPORT sf_texture_cache sf_texture_cache_new(size_t budget);
+/// Free every texture in a cache, even ones that are still referenced.
+EXPORT void sf_texture_cache_delete(sf_texture_cache *cache);
+
+/// Get a reference to the texture for a file, loading it with a full mip chain if it isn't cached.
+/// Give the reference back with sf_texture_cache_release.
+[[nodiscard]] EXPORT sf_result sf_texture_cache_load(sf_texture_cache *cache, sf_str path, sf_cached_texture **out);
+/// Take another reference to a cached texture.
+static inline sf_cached_texture *sf_texture_cache_retain(sf_cached_texture *texture) {
+    texture->refs++;
+    return texture;
+}
+/// Give back a reference. The texture stays cached until it's evicted to make room.
+EXPORT void sf_texture_cache_release(sf_texture_cache *cache, sf_cached_texture *texture);
+/// Evict unreferenced textures, least recently used first, until the cache fits its budget.
+/// Loading and releasing do this on their own, call it after lowering the budget.
+EXPORT void sf_texture_cache_trim(sf_texture_cache *cache);
+
+#endif // CACHE_H
@@ -4,6 +4,8 @@
 #include <sf/numerics.h>
 #include <cglm/cglm.h>
 #include "export.h"
+#include "sf/bounds.h"
+#include "sf/targets.h"
 #include "shaders.h"
 #include "textures.h"
 #include "glad/glad.h"
@@ -14,6 +16,12 @@ typedef enum {
     SF_CAMERA_ORTHOGRAPHIC,
 } sf_camera_type;
 
+/// The contents of a camera's uniform buffer, laid out like SF_GLSL_CAMERA_BLOCK (std140).
+typedef struct {
+    mat4 projection;
+    mat4 campos;
+} sf_camera_block;
+
 /// A movable camera.
 typedef struct {
     sf_camera_type type;
@@ -21,16 +29,38 @@ typedef struct {
     float fov, near, far;
     mat4 projection;
 
+    GLuint ubo;
+    sf_camera_block block; /// Projection and view as of the last refresh.
+    bool stale; /// The block changed since it was last written to the uniform buffer.
+    sf_frustum frustum; /// World space view volume as of the last refresh, draws outside of it are culled.
+
     GLuint framebuffer;
+    /// Attachments of the framebuffer, from the pool of the window that last used the camera.
+    /// They're rounded up to a bucket, the camera renders into the bottom left size pixels of them.
     sf_texture fb_color, fb_stencil;
+    sf_target_pool *targets;
+    sf_vec2 size;
     sf_rgba clear_color;
 } sf_camera;
 
 /// Create a new camera with its own framebuffer.
 EXPORT sf_camera sf_camera_new(sf_camera_type type, float fov, float near, float far);
-/// Delete a camera and its framebuffer.
+/// Delete a camera and its framebuffer, giving its attachments back to their pool.
 EXPORT void sf_camera_delete(sf_camera *camera);
 
+/// Rebuild a camera's block and frustum from its projection and transform, parents included.
+/// Only touches the camera, not OpenGL, so it works without a context.
+EXPORT void sf_camera_refresh(sf_camera *camera);
+/// Refresh a camera, then write its block to its uniform buffer, creating it if needed.
+/// Nothing is uploaded if the block hasn't changed. Every draw does this, so cameras are never drawn with a stale view.
+EXPORT void sf_camera_update(sf_camera *camera);
+/// Bind a camera's uniform buffer to SF_CAMERA_BINDING, as of its last update.
+[[nodiscard]] EXPORT sf_result sf_camera_bind(const sf_camera *camera);
+
+/// Get the world space ray through a point on a camera's image, in pixels from the top left of an image of size pixels.
+/// Refreshes the camera first.
+EXPORT sf_ray sf_camera_ray(sf_camera *camera, sf_vec2 point, sf_vec2 size);
+
 /// Get the right direction vector of a camera.
 EXPORT sf_vec3 sf_camera_right(const sf_camera *camera);
 /// Get the forward direction vector of a camera.
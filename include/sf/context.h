@@ -0,0 +1,30 @@
+#ifndef SF_CONTEXT_H
+#define SF_CONTEXT_H
+
+#include <sf/result.h>
+#include <sf/numerics.h>
+#include <glad/glad.h>
+#include "export.h"
+
+/// An OpenGL 3.3 core context without a window system, created through surfaceless EGL.
+/// It renders into an offscreen framebuffer that stands in for a window's default framebuffer,
+/// so it runs without a display and on software rasterizers like llvmpipe.
+/// Only available when the library is built with SF_HEADLESS.
+typedef struct {
+    void *display, *context;
+    GLuint framebuffer, color, depth_stencil;
+    sf_vec2 size;
+} sf_context;
+
+/// Create a headless context and its offscreen framebuffer, and make it current.
+/// Returns a result if EGL can't provide a surfaceless OpenGL context.
+[[nodiscard]] EXPORT sf_result sf_context_new(sf_context *out, sf_vec2 size);
+/// Destroy a headless context and its offscreen framebuffer.
+EXPORT void sf_context_delete(sf_context *context);
+
+/// Make a headless context current on this thread.
+EXPORT void sf_context_make_current(const sf_context *context);
+/// Resize a headless context's offscreen framebuffer.
+EXPORT void sf_context_resize(sf_context *context, sf_vec2 size);
+
+#endif // SF_CONTEXT_H
@@ -0,0 +1,82 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <threads.h>
+#include <sf/dynamic.h>
+#include <sf/result.h>
+#include "export.h"
+#include "sf/textures.h"
+
+/// Worker threads a loader starts when asked for none.
+#define SF_LOADER_WORKERS 4
+/// Bytes of pixels a loader uploads per frame when given no budget.
+#define SF_LOADER_BUDGET (4 * 1024 * 1024)
+
+typedef enum {
+    SF_TEXTURE_JOB_QUEUED, /// Waiting for a worker to read and decode the file.
+    SF_TEXTURE_JOB_UPLOADING, /// Decoded, uploading a few rows every frame.
+    SF_TEXTURE_JOB_DONE,
+    SF_TEXTURE_JOB_FAILED,
+} sf_texture_job_state;
+
+typedef struct sf_texture_job sf_texture_job;
+/// Called on the OpenGL thread when a job is done or failed, from sf_loader_update.
+typedef void (*sf_texture_callback)(sf_texture_job *job, void *user);
+
+/// A texture being loaded in the background.
+struct sf_texture_job {
+    /// The loader's 1x1 placeholder until the job is done, then the loaded texture. Safe to draw with at any time.
+    sf_texture texture;
+    sf_texture_job_state state;
+    sf_result result; /// Why the job failed, freed with the job.
+    sf_str path;
+    sf_texture_callback callback;
+    void *user;
+
+    uint8_t *pixels; /// Decoded RGBA rows, bottom first, until they're all uploaded.
+    sf_vec2 dimensions; /// Size of the decoded image.
+    sf_texture staging; /// The texture rows are uploaded into, swapped in once it's complete.
+    uint32_t rows; /// Rows uploaded so far.
+    bool cancelled; /// Deleted while a worker or the upload queue still had it.
+};
+
+/// Decodes textures on a pool of worker threads, and streams them to vram on the OpenGL thread
+/// a budgeted number of bytes per frame, so loading never stalls a frame for long.
+/// Uploads go through the current stream (see sf_stream_make_current) as a pixel unpack buffer when it has room.
+typedef struct {
+    thrd_t *workers;
+    size_t worker_count;
+    mtx_t lock;
+    cnd_t wake;
+    bool stopping;
+    /// Jobs waiting for a worker, oldest first from head, and jobs workers are finished with. Both guarded by lock.
+    sf_vec queue, decoded;
+    size_t head;
+
+    sf_vec jobs; /// Every job the loader owns, only touched on the OpenGL thread.
+    sf_vec uploads; /// Decoded jobs in the order they're uploaded.
+    size_t budget; /// Bytes uploaded per frame.
+    sf_texture placeholder;
+} sf_loader;
+
+/// Create a loader with some worker threads and a per-frame upload budget in bytes, 0 for the defaults.
+/// Must be called on the OpenGL thread, it creates the placeholder texture.
+[[nodiscard]] EXPORT sf_result sf_loader_new(sf_loader *out, size_t workers, size_t budget);
+/// Stop a loader's workers and delete every job it still owns, along with their textures.
+EXPORT void sf_loader_delete(sf_loader *loader);
+
+/// Start loading a texture from a file, with a full mip chain. Returns immediately, the job's texture is a placeholder
+/// until a worker decodes it and sf_loader_update has uploaded all of it. The callback may be nullptr.
+[[nodiscard]] EXPORT sf_texture_job *sf_texture_load_async(sf_loader *loader, sf_str path, sf_texture_callback callback, void *user);
+/// Whether a job has finished, successfully or not. A failed job keeps the placeholder.
+static inline bool sf_texture_job_done(const sf_texture_job *job) {
+    return job->state == SF_TEXTURE_JOB_DONE || job->state == SF_TEXTURE_JOB_FAILED;
+}
+/// Cancel a job if it's still running, and delete it along with its texture.
+EXPORT void sf_texture_job_delete(sf_loader *loader, sf_texture_job *job);
+
+/// Upload decoded textures, up to the loader's budget, and call the callbacks of jobs that finished.
+/// Call it once per frame on the OpenGL thread.
+EXPORT void sf_loader_update(sf_loader *loader);
+
+#endif // LOADER_H
@@ -0,0 +1,43 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "sf/meshes.h"
+
+/// Most levels a chain can have, including the original mesh.
+#define SF_MESH_LOD_MAX 8
+/// Default screen space error, in pixels, that a level of detail may have before a finer one is drawn.
+#define SF_MESH_LOD_THRESHOLD 1.0f
+
+/// Build a simplified copy of a mesh with about target_ratio of its triangles, by collapsing the edges
+/// that change its surface the least (quadric error metrics). Collapses stop early once they would move the surface
+/// further than max_error, relative to the mesh's largest dimension, so 0.01 allows 1% of its size.
+/// Vertices keep their exact attributes, those on uv or color seams aren't moved and open borders only move along themselves.
+[[nodiscard]] EXPORT sf_mesh sf_mesh_simplify(const sf_mesh *src, float target_ratio, float max_error);
+
+/// A chain of increasingly simplified versions of a mesh, drawn at the coarsest level that still looks right.
+typedef struct {
+    sf_mesh *base; /// Level 0, the original mesh. It isn't owned by the chain.
+    sf_mesh levels[SF_MESH_LOD_MAX - 1]; /// levels[i] is level i + 1.
+    float errors[SF_MESH_LOD_MAX]; /// How far each level's surface may be from the original's, in model space.
+    size_t count; /// Number of levels, including the original mesh.
+    sf_vec3 center; /// Center of the mesh's bounding sphere in model space.
+    float radius;
+    float threshold; /// Screen space error in pixels tolerated when picking a level, SF_MESH_LOD_THRESHOLD by default.
+} sf_mesh_lod;
+
+/// Build a chain of up to count levels for a mesh, each with about half the triangles of the one before.
+/// The chain ends early once a level can't be simplified further within max_error, see sf_mesh_simplify.
+/// The mesh itself is level 0, it isn't copied and must outlive the chain.
+[[nodiscard]] EXPORT sf_mesh_lod sf_mesh_lod_new(sf_mesh *mesh, size_t count, float max_error);
+/// Free the simplified levels of a chain, the original mesh is left alone.
+EXPORT void sf_mesh_lod_delete(sf_mesh_lod *lod);
+
+/// Pick the coarsest level whose error, projected by the camera, is within the chain's threshold.
+/// The camera is refreshed and its projection and view are used, with the height of its framebuffer in pixels.
+EXPORT size_t sf_mesh_lod_select(const sf_mesh_lod *lod, sf_camera *camera, const mat4 model);
+/// Draw the level of a chain that suits its distance from the camera, like sf_mesh_draw.
+EXPORT sf_result sf_mesh_lod_draw(sf_mesh_lod *lod, sf_shader *shader, sf_camera *camera, sf_transform transform, const sf_texture *texture);
+/// Draw the level of a chain that suits its distance from the camera, with an already computed model matrix.
+EXPORT sf_result sf_mesh_lod_draw_matrix(sf_mesh_lod *lod, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture);
+
+#endif // LOD_H
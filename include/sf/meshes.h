@@ -2,42 +2,87 @@
 #define MESHES_H
 
 #include <sf/numerics.h>
+#include "sf/bounds.h"
 #include "sf/camera.h"
 #include "sf/shaders.h"
 #include "sf/textures.h"
+#include "sf/vertices.h"
 
 /// Camera that renders to the default framebuffer instead of its own framebuffer.
-extern const sf_camera *SF_RENDER_DEFAULT;
-
-/// Contains vertex data for composing a mesh.
-#pragma pack(push, 1)
-typedef struct {
-    sf_vec3 position;
-    sf_vec2 uv;
-    sf_glcolor color;
-} sf_vertex;
-#pragma pack(pop)
+extern sf_camera *const SF_RENDER_DEFAULT;
 
 /// A bitfield containing information about an active mesh.
 typedef uint8_t sf_mesh_flags;
 #define SF_MESH_ACTIVE (sf_mesh_flags)0b10000000
 #define SF_MESH_VISIBLE (sf_mesh_flags)0b01000000
 
+/// First vertex attribute location of the per-instance model matrix.
+/// The matrix takes up four consecutive locations, one per column (3-6).
+#define SF_INSTANCE_ATTRIBUTE 3
+
+/// Most vertices a mesh can have while its indices are stored as 16-bit in vram.
+#define SF_MESH_SHORT_INDICES 65536
+
+/// Smallest number of elements a mesh's gpu buffers are allocated with.
+#define SF_MESH_MIN_CAPACITY 64
+
+/// A slot in a vertex table, index is -1 if the slot is empty.
+typedef struct {
+    uint32_t hash;
+    int32_t index;
+} sf_vertex_slot;
+
+/// Flat open-addressing table from vertex contents to their index in a mesh, used to weld duplicates.
+/// Keys aren't copied, slots point back into the mesh's vertices.
+typedef struct {
+    sf_vertex_slot *slots;
+    size_t capacity, count; /// Capacity is always a power of two.
+    bool stale; /// Vertices were rewritten in place, the table is rebuilt before the next vertex is added.
+} sf_vertex_table;
+
+/// A half-open range [begin, end) of elements that need to be copied to vram.
+typedef struct {
+    size_t begin, end;
+} sf_mesh_range;
+
 /// A mesh containing data for drawing a 3d model of any variety.
+/// Changes are uploaded lazily, see sf_mesh_update.
 typedef struct {
-    GLuint vao, vbo, ebo;
+    GLuint vao, vbo, ebo, ibo;
     sf_vec vertices, indices; /// Should contain no more than INT_MAX vertices.
-    sf_map cache;
+    sf_vertex_layout layout;
+    /// Type of the indices in vram, GL_UNSIGNED_SHORT until the mesh has more than SF_MESH_SHORT_INDICES vertices.
+    GLenum index_type;
+    sf_vertex_table cache;
+    sf_bounds bounds; /// Model space bounds of the vertices, recomputed by sf_mesh_update whenever they change.
+    size_t vbo_capacity, ebo_capacity, ibo_capacity; /// Number of elements the gpu buffers can hold.
+    sf_mesh_range dirty_vertices, dirty_indices;
     sf_mesh_flags flags;
 } sf_mesh;
 
+/// Set up the bound vertex array's per-instance model matrix, reading from ibo.
+EXPORT void sf_instance_attributes(GLuint ibo);
+/// Point the bound vertex array's instance attributes at model matrices starting at offset in buffer, and enable them.
+/// Draws that change buffers respecify this every time, a stream that grew can hand out a new buffer with the old one's name.
+EXPORT void sf_instance_source(GLuint buffer, GLintptr offset);
+/// Make the bound vertex array's instance attributes read a constant identity matrix, for draws without instances,
+/// so shaders written for instancing also work with sf_mesh_draw.
+EXPORT void sf_instance_identity();
+
 /// Create a new, empty mesh.
 [[nodiscard]] EXPORT sf_mesh sf_mesh_new();
 /// Free a mesh and delete all of its vertices.
 EXPORT void sf_mesh_delete(sf_mesh *mesh);
+/// Change how a mesh's vertices are stored in vram, they're uploaded again on the next update.
+/// New meshes use SF_VERTEX_LAYOUT_DEFAULT.
+EXPORT void sf_mesh_set_layout(sf_mesh *mesh, sf_vertex_layout layout);
 
-/// Copy a mesh to vram (Vertex Buffer)
-EXPORT void sf_mesh_update(const sf_mesh *mesh);
+/// Copy a mesh's pending changes to vram (Vertex Buffer).
+/// This is done automatically by sf_mesh_draw, but can be called to control when the upload happens.
+EXPORT void sf_mesh_update(sf_mesh *mesh);
+/// Mark a range of vertices as modified, so they are uploaded on the next update.
+/// Use this after writing to mesh->vertices directly, it also makes the next added vertex rebuild the weld table.
+EXPORT void sf_mesh_touch(sf_mesh *mesh, size_t first, size_t count);
 /// Add a single vertex to a mesh's model.
 EXPORT void sf_mesh_add_vertex(sf_mesh *mesh, sf_vertex vertex);
 /// Add an array of vertices to a mesh's model.
@@ -45,6 +90,14 @@ EXPORT void sf_mesh_add_vertices(sf_mesh *mesh, const sf_vertex *vertices, size_
 
 /// Draw a mesh to the framebuffer of the specified camera.
 /// To draw to the default framebuffer, pass SF_RENDER_DEFAULT.
-EXPORT sf_result sf_mesh_draw(const sf_mesh *mesh, sf_shader *shader, const sf_camera *camera, sf_transform transform, const sf_texture *texture);
+/// Nothing is drawn if the mesh's bounding sphere is outside the camera's frustum.
+EXPORT sf_result sf_mesh_draw(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, sf_transform transform, const sf_texture *texture);
+/// Draw a mesh with an already computed model matrix, such as a world matrix from an sf_transform_tree.
+EXPORT sf_result sf_mesh_draw_matrix(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture);
+/// Draw count copies of a mesh with a single draw call, one per transform.
+/// Model matrices are written to the current stream, or to the mesh's instance buffer without one.
+/// Read them in the shader through a mat4 attribute at SF_INSTANCE_ATTRIBUTE instead of the m_model uniform.
+/// Copies outside the camera's frustum are left out, so gl_InstanceID doesn't match their position in transforms.
+EXPORT sf_result sf_mesh_draw_instanced(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const sf_transform *transforms, size_t count, const sf_texture *texture);
 
 #endif // MESHES_H
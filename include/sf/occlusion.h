@@ -0,0 +1,64 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <sf/dynamic.h>
+#include "sf/meshes.h"
+
+/// Width and height in pixels of the tiles occluders are binned into, both sides of a depth buffer are a multiple of it.
+#define SF_OCCLUSION_TILE 32
+/// Most levels a depth pyramid can have, enough for a 32768 pixel wide buffer.
+#define SF_OCCLUSION_LEVELS 16
+
+/// What a depth buffer did since the last sf_occlusion_begin.
+typedef struct {
+    size_t occluder_triangles; /// Triangles rasterized, after clipping against the near plane.
+    size_t tested, culled; /// Boxes tested against the pyramid, and how many of them were hidden.
+} sf_occlusion_stats;
+
+/// A low resolution depth buffer rendered on the cpu from a handful of occluders, and the max-depth pyramid built from it.
+/// Boxes entirely behind the occluders can then be skipped before they're drawn, without reading anything back from the gpu.
+/// Depths go from 0 at the near plane to 1 at the far plane, pixel rows start from the bottom of the image.
+typedef struct {
+    const sf_camera *camera; /// Camera the buffer was last rendered from, see sf_occlusion_begin.
+    mat4 clip; /// The camera's projection * view.
+    uint32_t width, height;
+    /// Every level of the pyramid in one allocation, level 0 is the depth buffer itself.
+    /// Each texel of a level holds the farthest depth of the 2x2 texels under it.
+    float *depth;
+    size_t offsets[SF_OCCLUSION_LEVELS];
+    uint32_t widths[SF_OCCLUSION_LEVELS], heights[SF_OCCLUSION_LEVELS];
+    uint32_t levels;
+
+    sf_vec triangles; /// Occluder triangles in pixels, waiting for sf_occlusion_finish.
+    uint32_t *bins, *bin_offsets; /// Triangle indices grouped by tile.
+    size_t bin_capacity;
+    sf_occlusion_stats stats;
+} sf_occlusion;
+
+/// Create a depth buffer of about size pixels, rounded up to whole tiles.
+/// A few hundred pixels wide is plenty, only large occluders matter.
+[[nodiscard]] EXPORT sf_occlusion sf_occlusion_new(sf_vec2 size);
+/// Free a depth buffer and its pyramid.
+EXPORT void sf_occlusion_delete(sf_occlusion *occlusion);
+
+/// Clear the depth buffer and statistics, and start rendering occluders through a camera.
+/// Refreshes the camera and uses its projection and view, see sf_camera_refresh.
+EXPORT void sf_occlusion_begin(sf_occlusion *occlusion, sf_camera *camera);
+/// Add indexed triangles to the depth buffer, moved into world space by a model matrix.
+/// Only add closed, solid geometry that fills its pixels, like walls and floors.
+/// Triangles are drawn from both sides.
+EXPORT void sf_occlusion_add_triangles(sf_occlusion *occlusion, const sf_vertex *vertices, const int32_t *indices, size_t index_count, const mat4 model);
+/// Add a mesh's triangles to the depth buffer. Simplified meshes (see sf_mesh_simplify) make cheaper occluders,
+/// as long as they stay inside the original.
+static inline void sf_occlusion_add_mesh(sf_occlusion *occlusion, const sf_mesh *mesh, const mat4 model) {
+    sf_occlusion_add_triangles(occlusion, mesh->vertices.data, mesh->indices.data, mesh->indices.count, model);
+}
+/// Rasterize every occluder added since sf_occlusion_begin, and build the pyramid boxes are tested against.
+EXPORT void sf_occlusion_finish(sf_occlusion *occlusion);
+
+/// Whether any part of a world space box may be visible past the occluders. Counted in the statistics.
+/// Boxes crossing the near plane or leaving the screen are always visible, frustum culling deals with those.
+/// Only what shows through gaps narrower than a pixel of the buffer can be culled wrongly.
+EXPORT bool sf_occlusion_test(sf_occlusion *occlusion, sf_aabb box);
+
+#endif // OCCLUSION_H
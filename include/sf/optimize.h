@@ -0,0 +1,31 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "sf/meshes.h"
+
+/// Entries in the least recently used cache triangles are ordered against.
+#define SF_OPTIMIZE_CACHE_SIZE 32
+/// Entries in the first in first out cache that sf_mesh_analyze simulates, typical of desktop gpus.
+#define SF_ANALYZE_CACHE_SIZE 16
+
+/// How well a mesh's triangle order reuses the post-transform vertex cache.
+typedef struct {
+    float acmr; /// Average cache miss ratio, vertices shaded per triangle. 3 is the worst, ~0.5 the best for large grids.
+    float atvr; /// Average transformed vertex ratio, vertices shaded per vertex in the mesh. 1 is the best.
+} sf_vertex_cache_stats;
+
+/// Vertex cache statistics from before and after sf_mesh_optimize.
+typedef struct {
+    sf_vertex_cache_stats before, after;
+    size_t clusters; /// Number of triangle clusters reordered to reduce overdraw.
+} sf_optimize_stats;
+
+/// Simulate a fifo vertex cache of cache_size entries over a mesh's indices.
+EXPORT sf_vertex_cache_stats sf_mesh_analyze(const sf_mesh *mesh, size_t cache_size);
+/// Reorder a mesh for the gpu: triangles for vertex cache reuse (Forsyth's algorithm),
+/// clusters of those triangles front to back from the outside in to reduce overdraw,
+/// and finally vertices into the order they're first used so fetches are sequential.
+/// The mesh looks the same afterwards, and is uploaded again on the next update.
+EXPORT sf_optimize_stats sf_mesh_optimize(sf_mesh *mesh);
+
+#endif // OPTIMIZE_H
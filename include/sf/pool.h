@@ -0,0 +1,105 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "sf/meshes.h"
+
+/// Elements in the smallest block a mesh pool hands out.
+#define SF_POOL_BLOCK 16
+/// Largest number of orders a buddy allocator can have.
+#define SF_BUDDY_MAX_ORDERS 32
+
+/// A buddy allocator over a power of two number of blocks.
+/// Free blocks are kept in intrusive lists per order, so allocating and freeing are O(log blocks).
+typedef struct {
+    uint32_t blocks;
+    uint8_t orders;
+    uint32_t heads[SF_BUDDY_MAX_ORDERS]; /// First free block of each order, UINT32_MAX if there's none.
+    uint32_t *next, *prev;
+    uint8_t *order; /// Order of the free block starting at each block, UINT8_MAX if none starts there.
+} sf_buddy;
+
+/// A range of elements in one of a pool's buffers.
+typedef struct {
+    uint32_t first, count;
+} sf_pool_range;
+
+/// A mesh living in a pool, or a link in the pool's list of free entries.
+typedef struct {
+    sf_pool_range vertices, indices;
+    sf_bounds bounds; /// Model space bounds of the mesh's vertices, draws outside the camera's frustum are culled.
+    int32_t next_free; /// SF_POOL_USED while the entry holds a mesh.
+} sf_pool_entry;
+#define SF_POOL_USED (-2)
+
+/// Handle to a mesh in a pool. Handles stay valid until the mesh is removed, even across compaction.
+typedef int32_t sf_pool_handle;
+
+/// Many small meshes sharing one vertex array and one set of buffers.
+/// Vertex and index ranges are suballocated with buddy allocators and the buffers grow when they're full,
+/// so drawing a pooled mesh never switches vertex arrays.
+typedef struct {
+    GLuint vao, vbo, ebo, ibo;
+    sf_vertex_layout layout;
+    size_t ibo_capacity; /// Number of model matrices the instance buffer can hold.
+    sf_buddy vertex_blocks, index_blocks;
+    sf_pool_entry *entries;
+    size_t entry_count, entry_capacity;
+    int32_t free_entry; /// First free entry, -1 if there's none.
+} sf_mesh_pool;
+
+/// Create a pool storing vertices in a layout, with room for at least vertex_capacity vertices and index_capacity indices.
+[[nodiscard]] EXPORT sf_mesh_pool sf_mesh_pool_new(sf_vertex_layout layout, size_t vertex_capacity, size_t index_capacity);
+/// Free a pool and every mesh in it.
+EXPORT void sf_mesh_pool_delete(sf_mesh_pool *pool);
+
+/// Copy a mesh's vertices and indices into the pool, indices are relative to the mesh's first vertex.
+/// The vertices and indices of an sf_mesh can be added directly, the sf_mesh can be deleted afterwards.
+EXPORT sf_pool_handle sf_mesh_pool_add(sf_mesh_pool *pool, const sf_vertex *vertices, size_t vertex_count, const int32_t *indices, size_t index_count);
+/// Remove a mesh from the pool, freeing its ranges.
+EXPORT void sf_mesh_pool_remove(sf_mesh_pool *pool, sf_pool_handle mesh);
+/// Repack every mesh to the front of the buffers, largest first, so freed space coalesces into big blocks again.
+/// Handles are unaffected.
+EXPORT void sf_mesh_pool_compact(sf_mesh_pool *pool);
+
+/// Draw a pooled mesh to the framebuffer of the specified camera, like sf_mesh_draw.
+/// Nothing is drawn if the mesh's bounding sphere is outside the camera's frustum.
+EXPORT sf_result sf_mesh_pool_draw(sf_mesh_pool *pool, sf_pool_handle mesh, sf_shader *shader, sf_camera *camera, sf_transform transform, const sf_texture *texture);
+/// Draw a pooled mesh with an already computed model matrix, like sf_mesh_draw_matrix.
+EXPORT sf_result sf_mesh_pool_draw_matrix(sf_mesh_pool *pool, sf_pool_handle mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture);
+
+/// One indirect draw, laid out like OpenGL's DrawElementsIndirectCommand.
+typedef struct {
+    uint32_t count, instance_count, first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+} sf_draw_command;
+
+/// Draws of pooled meshes that share a shader, camera and texture, submitted together.
+/// Every draw's model matrix goes into one array, and base_instance points each command at its own,
+/// so shaders read it through the mat4 attribute at SF_INSTANCE_ATTRIBUTE like sf_mesh_draw_instanced.
+/// With OpenGL 4.3 a whole batch is a single glMultiDrawElementsIndirect call.
+typedef struct {
+    sf_vec commands, models;
+    sf_vec spheres; /// World space bounding sphere of each model's draw, culled against the camera when the batch is drawn.
+    GLuint indirect;
+    size_t indirect_capacity; /// Number of commands the indirect buffer can hold.
+} sf_pool_batch;
+
+/// Create a new, empty batch.
+[[nodiscard]] EXPORT sf_pool_batch sf_pool_batch_new();
+/// Free a batch and its buffers.
+EXPORT void sf_pool_batch_delete(sf_pool_batch *batch);
+
+/// Add a draw of a pooled mesh to the batch.
+/// Consecutive draws of the same mesh are merged into one instanced command.
+EXPORT void sf_pool_batch_push(sf_pool_batch *batch, const sf_mesh_pool *pool, sf_pool_handle mesh, sf_transform transform);
+/// Add a draw of a pooled mesh with an already computed model matrix.
+EXPORT void sf_pool_batch_push_matrix(sf_pool_batch *batch, const sf_mesh_pool *pool, sf_pool_handle mesh, const mat4 model);
+/// Submit every draw in the batch and clear it.
+/// Draws outside the camera's frustum are culled first, commands left without instances are dropped.
+/// Without OpenGL 4.3 the commands are drawn one at a time with glDrawElementsInstancedBaseVertex.
+EXPORT sf_result sf_pool_batch_draw(sf_pool_batch *batch, sf_mesh_pool *pool, sf_shader *shader, sf_camera *camera, const sf_texture *texture);
+/// Drop every draw in the batch without submitting them.
+EXPORT void sf_pool_batch_clear(sf_pool_batch *batch);
+
+#endif // POOL_H
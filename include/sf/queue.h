@@ -0,0 +1,53 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <sf/dynamic.h>
+#include "sf/meshes.h"
+#include "sf/occlusion.h"
+
+/// A draw waiting in a render queue.
+typedef struct {
+    sf_mesh *mesh;
+    sf_shader *shader;
+    sf_camera *camera;
+    const sf_texture *texture;
+    mat4 model;
+} sf_render_item;
+
+/// A render item's sort key and its position in the queue.
+typedef struct {
+    uint64_t key;
+    uint32_t index;
+} sf_render_key;
+
+/// Collects draws and submits them sorted by state, so only the binds that change between
+/// neighbouring draws are issued.
+/// Keys are ordered by framebuffer, then shader program, texture and vertex array.
+/// Draws outside their camera's frustum are culled before sorting,
+/// as are draws through the occlusion buffer's camera whose boxes are hidden in it.
+typedef struct {
+    sf_vec items;
+    sf_render_key *keys, *scratch;
+    sf_sphere *spheres; /// World space bounds of each draw, for culling.
+    uint32_t *visible;
+    size_t key_capacity;
+    /// Depth buffer to test draws against, if any. Finish it before flushing, see sf_occlusion_finish.
+    sf_occlusion *occlusion;
+} sf_render_queue;
+
+/// Create a new, empty render queue.
+[[nodiscard]] EXPORT sf_render_queue sf_render_queue_new();
+/// Free a render queue and any draws still in it.
+EXPORT void sf_render_queue_delete(sf_render_queue *queue);
+
+/// Add a draw to the queue. Takes the same arguments as sf_mesh_draw.
+/// Everything passed in must stay alive until the queue is flushed.
+EXPORT void sf_render_queue_push(sf_render_queue *queue, sf_mesh *mesh, sf_shader *shader, sf_camera *camera, sf_transform transform, const sf_texture *texture);
+/// Add a draw with an already computed model matrix. Takes the same arguments as sf_mesh_draw_matrix.
+EXPORT void sf_render_queue_push_matrix(sf_render_queue *queue, sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture);
+/// Sort and draw everything in the queue, then empty it.
+[[nodiscard]] EXPORT sf_result sf_render_queue_flush(sf_render_queue *queue);
+/// Drop every draw in the queue without drawing.
+EXPORT void sf_render_queue_clear(sf_render_queue *queue);
+
+#endif // QUEUE_H
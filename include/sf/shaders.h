@@ -6,26 +6,97 @@
 #include <glad/glad.h>
 #include <cglm/cglm.h>
 #include "export.h"
+#include "sf/state.h"
+#include "sf/transforms.h"
+
+/// A handle to one of a shader's active uniforms, an index into its uniform table.
+typedef int32_t sf_uniform;
+/// A uniform handle that doesn't refer to anything, setting it does nothing.
+#define SF_UNIFORM_NONE (sf_uniform)-1
+
+/// Uniform buffer binding point of the camera block, see sf_camera_update.
+#define SF_CAMERA_BINDING 0
+/// The standard camera uniform block, paste it into shaders drawn by sf_mesh_draw.
+/// Programs using it are bound to SF_CAMERA_BINDING when they're linked.
+#define SF_GLSL_CAMERA_BLOCK \
+    "layout(std140) uniform sf_camera {\n" \
+    "    mat4 m_projection;\n" \
+    "    mat4 m_campos;\n" \
+    "};\n"
+
+/// An active uniform found when a shader was linked.
+typedef struct {
+    sf_str name;
+    GLint location;
+    GLenum type;
+} sf_uniform_info;
 
 /// An OpenGL shader program and its vertex/fragment glsl shaders.
-/// Uniform locations are automatically cached as you use them.
+/// Active uniforms are reflected into a table when the program is linked.
 typedef struct {
     sf_str path;
     GLuint vertex, fragment, program;
-    sf_map uniforms;
+    sf_uniform_info *uniforms;
+    size_t uniform_count;
+    /// Handles of the uniforms the library sets itself, SF_UNIFORM_NONE if the shader doesn't use them.
+    struct {
+        sf_uniform model, sampler;
+    } builtin;
 } sf_shader;
 
 /// Compile and link shaders into a program.
 /// Returns a result if it fails.
 [[nodiscard]] EXPORT sf_result sf_shader_new(sf_shader *out, sf_str path);
 /// Free a shader and its code/program.
-/// Cached uniforms will be reset.
+/// Its uniform handles will be invalidated.
 EXPORT void sf_shader_free(sf_shader *shader);
 
+/// Counters for the program binary cache.
+/// Rejected binaries are ones the driver refused, they're recompiled and counted as misses too.
+typedef struct {
+    uint32_t hits, misses, rejected;
+} sf_shader_cache_stats;
+
+/// Cache linked program binaries in a directory, which must already exist.
+/// Binaries are keyed by the shader sources and the driver's vendor, renderer and version,
+/// and sf_shader_new falls back to compiling whenever a binary can't be used.
+/// Does nothing on drivers without program binary support (OpenGL 4.1).
+EXPORT void sf_shader_cache_enable(sf_str directory);
+/// Stop caching program binaries.
+EXPORT void sf_shader_cache_disable();
+/// Get the program binary cache's hit and miss counters.
+EXPORT sf_shader_cache_stats sf_shader_cache_get_stats();
+
 /// Bind to the shader's OpenGL program.
-static inline void sf_shader_bind(const sf_shader *shader) { glUseProgram(shader->program); }
+static inline void sf_shader_bind(const sf_shader *shader) { sf_gl_use_program(shader->program); }
+
+/// Look up a uniform's handle by name. Do this once when setting up, handles are valid until the shader is freed.
+/// Returns a result if the shader has no active uniform with that name.
+[[nodiscard]] EXPORT sf_result sf_shader_uniform(const sf_shader *shader, sf_str name, sf_uniform *out);
+
+/// Set a bound shader's float uniform through its handle.
+static inline void sf_shader_set_float(const sf_shader *shader, const sf_uniform u, const float value) {
+    if (u >= 0) glUniform1f(shader->uniforms[u].location, value);
+}
+/// Set a bound shader's int uniform through its handle.
+static inline void sf_shader_set_int(const sf_shader *shader, const sf_uniform u, const int value) {
+    if (u >= 0) glUniform1i(shader->uniforms[u].location, value);
+}
+/// Set a bound shader's vector2 uniform through its handle.
+static inline void sf_shader_set_vec2(const sf_shader *shader, const sf_uniform u, const sf_vec2 value) {
+    if (u >= 0) glUniform2f(shader->uniforms[u].location, value.x, value.y);
+}
+/// Set a bound shader's vector3 uniform through its handle.
+static inline void sf_shader_set_vec3(const sf_shader *shader, const sf_uniform u, const sf_vec3 value) {
+    if (u >= 0) glUniform3f(shader->uniforms[u].location, value.x, value.y, value.z);
+}
+/// Set a bound shader's matrix uniform through its handle.
+static inline void sf_shader_set_mat4(const sf_shader *shader, const sf_uniform u, const mat4 value) {
+    if (u >= 0) glUniformMatrix4fv(shader->uniforms[u].location, 1, false, (const GLfloat *)value);
+}
 
 /// Set a shader's float uniform to the desired value by name.
+/// The by-name setters look the uniform up on every call, prefer handles for anything per-frame.
 [[nodiscard]] EXPORT sf_result sf_shader_uniform_float(sf_shader *shader, sf_str name, float value);
 /// Set a shader's int uniform to the desired value by name.
 [[nodiscard]] EXPORT sf_result sf_shader_uniform_int(sf_shader *shader, sf_str name, int value);
@@ -86,9 +157,4 @@ static inline sf_str sf_glcolor_str(const sf_glcolor gl) {
 #define SF_WHITE (sf_rgba){255, 255, 255, 255}
 #define SF_BLACK (sf_rgba){0, 0, 0, 255}
 
-/// Turns an sf_transform into a model matrix.
-EXPORT void sf_transform_model(mat4 out, sf_transform transform);
-/// Turns an sf_transform into a view matrix.
-EXPORT void sf_transform_view(mat4 out, sf_transform transform);
-
 #endif // SHADERS_H
@@ -0,0 +1,83 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+#include "export.h"
+
+/// Number of texture units whose bindings are tracked.
+#define SF_GL_TEXTURE_UNITS 16
+/// Number of uniform buffer binding points whose bindings are tracked.
+#define SF_GL_UNIFORM_BINDINGS 16
+/// Marks a binding whose value isn't known, the next bind to it is always issued.
+#define SF_GL_UNKNOWN UINT32_MAX
+
+/// Buffer targets whose bindings are tracked, other targets are passed straight through.
+typedef enum {
+    SF_GL_ARRAY_BUFFER,
+    SF_GL_ELEMENT_ARRAY_BUFFER,
+    SF_GL_UNIFORM_BUFFER,
+    SF_GL_COPY_READ_BUFFER,
+    SF_GL_COPY_WRITE_BUFFER,
+    SF_GL_PIXEL_UNPACK_BUFFER,
+    SF_GL_BUFFER_TARGETS,
+} sf_gl_buffer_target;
+
+/// Number of binds issued to OpenGL, and the number skipped because the object was already bound.
+typedef struct {
+    uint32_t issued, elided;
+} sf_gl_stats;
+
+/// A shadow copy of the bindings of an OpenGL context.
+/// All of the library's binds go through the current state, which skips binds that wouldn't change anything.
+/// Zero initialized, it matches a freshly created context.
+typedef struct {
+    /// What binding framebuffer 0 means, for headless contexts that render into an offscreen framebuffer instead.
+    GLuint default_framebuffer;
+    GLuint framebuffer, program, vertex_array;
+    GLuint buffers[SF_GL_BUFFER_TARGETS];
+    GLuint uniform_buffers[SF_GL_UNIFORM_BINDINGS];
+    GLuint active_texture;
+    GLuint textures[SF_GL_TEXTURE_UNITS];
+    /// SF_RENDER_DEFAULT's uniform buffer in this context, created the first time it's bound.
+    /// Buffers aren't shared between contexts, so every context needs its own.
+    GLuint default_camera;
+
+    sf_gl_stats frame, last_frame;
+} sf_gl_state;
+
+/// Make a state the one tracking the current context. Call this whenever the context is made current.
+EXPORT void sf_gl_state_make_current(sf_gl_state *state);
+/// Get the state tracking the current context.
+EXPORT sf_gl_state *sf_gl_state_current();
+/// Forget every tracked binding, for when something outside the library changed the context.
+EXPORT void sf_gl_state_invalidate();
+/// Finish a frame's bind counters. sf_window_draw calls this after swapping buffers.
+EXPORT void sf_gl_state_end_frame();
+/// Get the bind counters of the last finished frame.
+EXPORT sf_gl_stats sf_gl_frame_stats();
+
+/// Bind a framebuffer, 0 binds the context's default framebuffer.
+EXPORT void sf_gl_bind_framebuffer(GLuint framebuffer);
+EXPORT void sf_gl_use_program(GLuint program);
+EXPORT void sf_gl_bind_vertex_array(GLuint vertex_array);
+EXPORT void sf_gl_bind_buffer(GLenum target, GLuint buffer);
+/// Bind a whole buffer to an indexed binding point, like glBindBufferBase.
+EXPORT void sf_gl_bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+/// Bind part of a buffer to an indexed binding point, like glBindBufferRange.
+/// Ranges aren't tracked, they're always bound.
+EXPORT void sf_gl_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+/// Select the active texture unit, as an offset from GL_TEXTURE0.
+EXPORT void sf_gl_active_texture(GLuint unit);
+/// Bind a 2d texture to the active texture unit.
+EXPORT void sf_gl_bind_texture(GLuint texture);
+
+/// Drop a deleted object from the tracked bindings.
+/// OpenGL unbinds deleted objects itself, so a new object reusing the name would be skipped otherwise.
+EXPORT void sf_gl_forget_framebuffer(GLuint framebuffer);
+EXPORT void sf_gl_forget_program(GLuint program);
+EXPORT void sf_gl_forget_vertex_array(GLuint vertex_array);
+EXPORT void sf_gl_forget_buffer(GLuint buffer);
+EXPORT void sf_gl_forget_texture(GLuint texture);
+
+#endif // STATE_H
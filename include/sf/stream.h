@@ -0,0 +1,65 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <sf/result.h>
+#include <glad/glad.h>
+#include "export.h"
+
+/// Number of frames a stream lets the gpu lag behind before writes wait on it.
+#define SF_STREAM_FRAMES 3
+/// Bytes per frame a window's stream starts out with, it grows if a frame needs more.
+#define SF_STREAM_DEFAULT_SIZE (4 * 1024 * 1024)
+
+/// A piece of a stream's buffer handed out for this frame.
+typedef struct {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} sf_stream_range;
+
+/// A ring buffer for data rewritten every frame, such as vertex updates, instance data and uniform blocks.
+/// It's split into one region per frame in flight, each fenced when its frame ends,
+/// so writing never waits on draws that still read the previous frames' data.
+/// With OpenGL 4.4 the buffer stays persistently mapped, otherwise it's orphaned every frame instead.
+typedef struct {
+    GLuint buffer;
+    size_t frame_size; /// Bytes each frame can allocate.
+    size_t head, missed; /// Bytes allocated this frame, and bytes of allocations that didn't fit.
+    size_t peak; /// The most bytes any frame asked for.
+    uint32_t frame;
+    GLsync fences[SF_STREAM_FRAMES];
+    uint8_t *persistent; /// Start of the mapped buffer, nullptr when orphaning.
+    bool mapped;
+    GLint uniform_alignment;
+
+    uint32_t stalls; /// Frames that had to wait for the gpu to release their region.
+} sf_stream;
+
+/// Create a stream with frame_size bytes available per frame.
+[[nodiscard]] EXPORT sf_result sf_stream_new(sf_stream *out, size_t frame_size);
+/// Delete a stream and its buffer.
+EXPORT void sf_stream_delete(sf_stream *stream);
+
+/// Make a stream the one the library streams its own uploads through, nullptr to upload directly.
+/// sf_window does this with its own stream.
+EXPORT void sf_stream_make_current(sf_stream *stream);
+/// Get the current stream, or nullptr.
+EXPORT sf_stream *sf_stream_current();
+
+/// Allocate size bytes from this frame's region and return where to write them, unmap the stream before drawing.
+/// The offset is a multiple of alignment, use stream->uniform_alignment for uniform blocks.
+/// Returns nullptr if the frame is out of space, the stream grows to fit when the frame ends.
+EXPORT void *sf_stream_map(sf_stream *stream, size_t size, size_t alignment, sf_stream_range *out);
+/// Finish writing to mapped ranges, so the gpu can read them.
+EXPORT void sf_stream_unmap(sf_stream *stream);
+/// Write data to the stream, returning false if it doesn't fit.
+[[nodiscard]] EXPORT bool sf_stream_write(sf_stream *stream, const void *data, size_t size, size_t alignment, sf_stream_range *out);
+/// Write data to the stream and have the gpu copy it into the buffer bound to target.
+/// Unlike glBufferSubData this never waits on draws still reading the destination.
+/// Returns false if it doesn't fit, upload directly instead.
+[[nodiscard]] EXPORT bool sf_stream_copy(sf_stream *stream, GLenum target, GLintptr offset, const void *data, size_t size);
+
+/// Fence the frame's region and move on to the next one. sf_window_draw calls this after swapping buffers.
+EXPORT void sf_stream_end_frame(sf_stream *stream);
+
+#endif // STREAM_H
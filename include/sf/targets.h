@@ -0,0 +1,47 @@
+#ifndef TARGETS_H
+#define TARGETS_H
+
+#include <sf/dynamic.h>
+#include "export.h"
+#include "sf/textures.h"
+
+/// Smallest side, in pixels, a pooled render target is allocated with.
+#define SF_TARGET_MIN_SIZE 64
+/// Frames a released render target is kept around for before it's freed.
+#define SF_TARGET_KEEP_FRAMES 1
+
+/// A texture owned by a render target pool.
+typedef struct {
+    sf_texture texture;
+    uint64_t released; /// Frame the texture was last released on.
+    bool used;
+} sf_target;
+
+/// Textures to render into, recycled between cameras and passes instead of being reallocated.
+/// Sizes are rounded up to a bucket so resizing a window a few pixels at a time keeps the same textures;
+/// render into the bottom left corner of the size you asked for and sample it with scaled uvs.
+typedef struct {
+    sf_vec targets;
+    uint64_t frame;
+} sf_target_pool;
+
+/// Round a size up to the bucket render targets of that size are allocated at.
+/// Each side goes to the next eighth of a power of two, so at most 1/8 of it is unused.
+EXPORT sf_vec2 sf_target_bucket(sf_vec2 size);
+
+/// Create a new, empty render target pool.
+[[nodiscard]] EXPORT sf_target_pool sf_target_pool_new();
+/// Free every texture in a pool, even ones that were never released.
+EXPORT void sf_target_pool_delete(sf_target_pool *pool);
+
+/// Get a texture that holds at least size pixels, reusing a released one of the same type and bucket if there is one.
+/// The texture's dimensions are the bucket's, not size. It's a render target without mips, see SF_TEXTURE_RENDER_TARGET.
+/// Give it back with sf_target_release.
+[[nodiscard]] EXPORT sf_texture sf_target_acquire(sf_target_pool *pool, sf_texture_type type, sf_vec2 size);
+/// Give a texture back to the pool it came from, so other cameras or passes can use it.
+/// Textures that aren't in the pool are ignored.
+EXPORT void sf_target_release(sf_target_pool *pool, const sf_texture *texture);
+/// Finish a frame, freeing textures that haven't been used for SF_TARGET_KEEP_FRAMES frames.
+EXPORT void sf_target_pool_end_frame(sf_target_pool *pool);
+
+#endif // TARGETS_H
@@ -5,6 +5,7 @@
 #include <sf/numerics.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "export.h"
 
 typedef enum {
     SF_TEXTURE_RGB,
@@ -12,19 +13,47 @@ typedef enum {
     SF_TEXTURE_DEPTH_STENCIL,
 } sf_texture_type;
 
+/// A bitfield describing how a texture is used, which decides what it's allocated with.
+typedef uint8_t sf_texture_usage;
+/// Read by shaders.
+#define SF_TEXTURE_SAMPLED (sf_texture_usage)0b00000001
+/// Sampled through a full mip chain, which is regenerated after the contents change.
+#define SF_TEXTURE_MIPMAPPED (sf_texture_usage)0b00000010
+/// Attached to a framebuffer. Render targets are clamped at their edges and only have one level.
+#define SF_TEXTURE_RENDER_TARGET (sf_texture_usage)0b00000100
+
 /// A wrapper around an OpenGL texture.
+/// Storage is immutable (glTexStorage2D) on OpenGL 4.2 and up, so the handle changes whenever it's resized.
 typedef struct {
     sf_texture_type type;
     GLuint handle;
     sf_vec2 dimensions;
+    sf_texture_usage usage;
+    uint8_t levels; /// Number of mip levels in vram, 1 unless the texture is mipmapped.
+    bool mips_dirty; /// Level 0 changed since the mip chain was last generated.
 } sf_texture;
+
+/// Number of mip levels a texture of some size is allocated with for a usage.
+EXPORT uint8_t sf_texture_levels(sf_vec2 dimensions, sf_texture_usage usage);
 /// Create an empty OpenGL texture.
-EXPORT sf_texture sf_texture_new(sf_texture_type type, sf_vec2 dimensions);
-/// Load a texture from a file and upload it to the gpu.
+EXPORT sf_texture sf_texture_new(sf_texture_type type, sf_vec2 dimensions, sf_texture_usage usage);
+/// Load a texture from a file and upload it to the gpu, with a full mip chain.
 EXPORT sf_result sf_texture_load(sf_texture *out, sf_str path);
 static inline sf_result sf_texture_cload(sf_texture *out, const char *path) { return sf_texture_load(out, sf_ref(path)); }
-/// Resize a texture without first deleting it.
+/// Decode an image file's contents, already in memory, and upload it to the gpu with a full mip chain.
+EXPORT sf_result sf_texture_load_memory(sf_texture *out, const uint8_t *data, size_t size);
+/// Replace all of a texture's first level, pixels are tightly packed rows of its type, bottom row first.
+/// Mips are regenerated on the next sf_texture_update.
+EXPORT void sf_texture_write(sf_texture *texture, const void *pixels);
+/// Mark a texture's contents as changed, after rendering to it.
+EXPORT void sf_texture_touch(sf_texture *texture);
+/// Regenerate a mipmapped texture's mip chain if its contents changed since the last time.
+EXPORT void sf_texture_update(sf_texture *texture);
+/// Resize a texture, losing its contents.
+/// Textures with immutable storage are recreated with a new handle, attach them to their framebuffers again.
 EXPORT void sf_texture_resize(sf_texture *texture, sf_vec2 dimensions);
+/// Bytes of vram a texture's levels take up.
+EXPORT size_t sf_texture_bytes(const sf_texture *texture);
 /// Free a texture's resources.
 EXPORT void sf_texture_delete(sf_texture *texture);
 
@@ -0,0 +1,73 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <sf/numerics.h>
+#include <cglm/cglm.h>
+#include "export.h"
+
+/// Turns an sf_transform into a model matrix.
+EXPORT void sf_transform_model(mat4 out, sf_transform transform);
+/// Turns an sf_transform into a view matrix.
+EXPORT void sf_transform_view(mat4 out, sf_transform transform);
+/// Turns count sf_transforms into model matrices, equal to calling sf_transform_model on each.
+/// Uses SSE to convert several transforms at once, or AVX2 on cpus that have it when built with SF_ENABLE_AVX2.
+EXPORT void sf_transform_models(mat4 *out, const sf_transform *transforms, size_t count);
+/// Turns an sf_transform into a matrix relative to its parent, ignoring transform.parent.
+/// Transforms with and without parents are composed in a different order, matching sf_transform_model.
+EXPORT void sf_transform_local(mat4 out, sf_transform transform, bool has_parent);
+
+/// A handle to a node in a transform tree.
+typedef int32_t sf_transform_node;
+/// A node handle that refers to nothing, used for nodes without a parent.
+#define SF_TRANSFORM_NONE (sf_transform_node)-1
+
+/// A hierarchy of transforms with cached world matrices, stored as structure of arrays.
+/// Parents are always added before their children, so a single pass in node order updates
+/// every world matrix at most once, parents first.
+typedef struct {
+    sf_vec3 *position, *rotation, *scale;
+    sf_transform_node *parent;
+    mat4 *world;
+    bool *dirty; /// The local transform changed since the last update.
+    size_t count, capacity;
+} sf_transform_tree;
+
+/// Create a new, empty transform tree.
+[[nodiscard]] EXPORT sf_transform_tree sf_transform_tree_new();
+/// Free a transform tree and all of its nodes.
+EXPORT void sf_transform_tree_delete(sf_transform_tree *tree);
+
+/// Add a node to a tree. The parent must already be in the tree, or SF_TRANSFORM_NONE.
+/// local.parent is ignored, the tree's own parent is used instead.
+/// Returns SF_TRANSFORM_NONE without adding anything if the parent isn't in the tree.
+[[nodiscard]] EXPORT sf_transform_node sf_transform_tree_add(sf_transform_tree *tree, sf_transform local, sf_transform_node parent);
+/// Replace a node's local transform.
+EXPORT void sf_transform_tree_set(sf_transform_tree *tree, sf_transform_node node, sf_transform local);
+/// Get a node's local transform.
+EXPORT sf_transform sf_transform_tree_get(const sf_transform_tree *tree, sf_transform_node node);
+
+/// Set a node's local position.
+static inline void sf_transform_tree_set_position(sf_transform_tree *tree, const sf_transform_node node, const sf_vec3 position) {
+    tree->position[node] = position;
+    tree->dirty[node] = true;
+}
+/// Set a node's local rotation in degrees.
+static inline void sf_transform_tree_set_rotation(sf_transform_tree *tree, const sf_transform_node node, const sf_vec3 rotation) {
+    tree->rotation[node] = rotation;
+    tree->dirty[node] = true;
+}
+/// Set a node's local scale.
+static inline void sf_transform_tree_set_scale(sf_transform_tree *tree, const sf_transform_node node, const sf_vec3 scale) {
+    tree->scale[node] = scale;
+    tree->dirty[node] = true;
+}
+
+/// Recompute the world matrices of every changed node and its descendants.
+/// Call this once per frame, after moving nodes and before drawing.
+EXPORT void sf_transform_tree_update(sf_transform_tree *tree);
+/// Get a node's world matrix as of the last update, to pass to sf_mesh_draw_matrix.
+static inline vec4 *sf_transform_tree_world(const sf_transform_tree *tree, const sf_transform_node node) {
+    return tree->world[node];
+}
+
+#endif // TRANSFORMS_H
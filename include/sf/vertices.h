@@ -0,0 +1,93 @@
+#ifndef VERTICES_H
+#define VERTICES_H
+
+#include <sf/numerics.h>
+#include <glad/glad.h>
+#include "export.h"
+#include "sf/shaders.h"
+
+/// Contains vertex data for composing a mesh.
+#pragma pack(push, 1)
+typedef struct {
+    sf_vec3 position;
+    sf_vec2 uv;
+    sf_glcolor color;
+} sf_vertex;
+#pragma pack(pop)
+
+/// How a vertex attribute is stored in vram.
+typedef enum : uint8_t {
+    SF_FORMAT_NONE,    /// Not stored, shaders read the attribute's default value.
+    SF_FORMAT_FLOAT,   /// 32-bit float.
+    SF_FORMAT_HALF,    /// 16-bit float, 11 bits of precision.
+    SF_FORMAT_UNORM8,  /// [0, 1] as an 8-bit normalized integer.
+    SF_FORMAT_UNORM16, /// [0, 1] as a 16-bit normalized integer.
+    SF_FORMAT_SNORM16, /// [-1, 1] as a 16-bit normalized integer.
+} sf_vertex_format;
+
+/// The attributes of an sf_vertex, numbered by their shader locations.
+typedef enum {
+    SF_ATTRIBUTE_POSITION,
+    SF_ATTRIBUTE_UV,
+    SF_ATTRIBUTE_COLOR,
+    SF_ATTRIBUTE_COUNT,
+} sf_vertex_attribute;
+
+/// How vertices are packed in vram.
+/// Meshes are always built from sf_vertex, and converted to their layout when they're uploaded.
+/// Attributes are padded to 4 bytes, so every one of them starts aligned.
+typedef struct {
+    sf_vertex_format formats[SF_ATTRIBUTE_COUNT];
+    uint8_t offsets[SF_ATTRIBUTE_COUNT];
+    uint8_t stride;
+} sf_vertex_layout;
+
+/// Describe a layout by the format of each attribute.
+EXPORT sf_vertex_layout sf_vertex_layout_new(sf_vertex_format position, sf_vertex_format uv, sf_vertex_format color);
+/// Every attribute as a float, laid out exactly like sf_vertex (36 bytes), so uploads skip packing.
+#define SF_VERTEX_LAYOUT_DEFAULT sf_vertex_layout_new(SF_FORMAT_FLOAT, SF_FORMAT_FLOAT, SF_FORMAT_FLOAT)
+/// Float positions, half uvs and RGBA8 colors (20 bytes).
+#define SF_VERTEX_LAYOUT_COMPACT sf_vertex_layout_new(SF_FORMAT_FLOAT, SF_FORMAT_HALF, SF_FORMAT_UNORM8)
+
+/// Convert vertices to a layout's format, writing count * layout->stride bytes.
+EXPORT void sf_vertex_pack(const sf_vertex_layout *layout, void *out, const sf_vertex *vertices, size_t count);
+/// Convert vertices to a layout's format and write them to the buffer bound to target, starting at offset bytes.
+/// Goes through the current stream when there's room, packing straight into it.
+EXPORT void sf_vertex_upload(const sf_vertex_layout *layout, GLenum target, GLintptr offset, const sf_vertex *vertices, size_t count);
+/// Set up the bound vertex array to read vertices in a layout from a vertex buffer.
+/// Attributes the layout doesn't store are disabled.
+EXPORT void sf_vertex_attributes(const sf_vertex_layout *layout, GLuint vbo);
+
+/// Convert a float to a 16-bit float, rounding to nearest even.
+static inline uint16_t sf_float_to_half(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFF) // Infinity and NaN
+        return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0));
+    const int32_t e = (int32_t)exponent - 127 + 15;
+    if (e >= 31) // Too large, round to infinity
+        return (uint16_t)(sign | 0x7C00u);
+    if (e <= 0) { // Subnormal or zero
+        if (e < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        const uint32_t shift = (uint32_t)(14 - e);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1), midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFFu;
+    // A carry out of the mantissa correctly bumps the exponent, up to infinity.
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+        half++;
+    return (uint16_t)(sign | half);
+}
+
+#endif // VERTICES_H
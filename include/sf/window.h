@@ -6,7 +6,10 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "sf/camera.h"
+#include "sf/context.h"
 #include "sf/key.h"
+#include "sf/state.h"
+#include "sf/stream.h"
 #include "export.h"
 #include "meshes.h"
 
@@ -14,17 +17,26 @@
 #define SF_WINDOW_VISIBLE       0b01000000
 #define SF_WINDOW_MAXIMIZED     0b00100000
 #define SF_WINDOW_FULLSCREEN    0b00010000
+/// Render offscreen through a surfaceless context instead of opening a window, see sf_context.
+/// Headless windows have no keyboard input and only close when the caller stops looping.
+#define SF_WINDOW_HEADLESS      0b00001000
 
 /// A window with an active OpenGL context and keyboard controls.
 typedef struct {
     GLFWwindow *handle;
+    /// The context of a headless window, which has no handle.
+    sf_context context;
     uint8_t hints;
     sf_str title;
     sf_vec2 size;
-    sf_vec2 mouse_position;
+    sf_vec2 mouse_position; /// In screen coordinates from the top left of the window, not pixels on HiDPI displays.
+    bool resized; /// Set by resize events, the camera is fit to the new size once per frame by sf_window_loop.
 
     sf_camera *camera;
     sf_mesh fb_mesh;
+    sf_gl_state gl;
+    sf_stream stream;
+    sf_target_pool targets; /// Attachments of the cameras drawn through this window.
 
     int8_t keyboard[GLFW_KEY_LAST + 1];
     uint8_t kb_p;
@@ -45,13 +57,20 @@ static inline bool sf_key_released(const sf_window *window, const sf_key key) {
 /// Get the string of keys pressed since the last time this function was called.
 [[nodiscard]] sf_str sf_key_string(sf_window *window);
 
-/// Update the camera the window is rendering from.
+/// Update the camera the window is rendering from, and fit its projection and attachments to the window's size.
+/// Attachments only change when the size leaves its bucket, see sf_target_bucket.
 EXPORT void sf_window_set_camera(sf_window *window, sf_camera *camera);
 /// Prepare for a frame, and/or return whether a window should close.
 /// Use this in a while loop.
-EXPORT bool sf_window_loop(const sf_window *window);
+EXPORT bool sf_window_loop(sf_window *window);
 /// Swap a window's buffers and finish the frame.
 EXPORT sf_result sf_window_draw(sf_window *window, sf_shader *post_shader);
+/// Read the last drawn frame back as RGBA8, bottom row first.
+/// `out` must hold size.x * size.y * 4 bytes.
+EXPORT void sf_window_read_pixels(sf_window *window, uint8_t *out);
+
+/// Get the world space ray under the mouse cursor, through the window's camera. Use it to pick objects, see sf_bvh_raycast.
+EXPORT sf_ray sf_window_mouse_ray(const sf_window *window);
 
 /// Set the displayed title of a window.
 EXPORT void sf_window_set_title(sf_window *window, const sf_str title);
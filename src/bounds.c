@@ -0,0 +1,162 @@
+#include "sf/bounds.h"
+#include "util.h"
+
+#include <float.h>
+
+static_assert(sizeof(sf_sphere) == 4 * sizeof(float), "sf_sphere is expected to be 4 packed floats.");
+
+sf_bounds sf_bounds_compute(const sf_vertex *vertices, const size_t count) {
+    if (count == 0)
+        return (sf_bounds){};
+    sf_aabb box = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+    for (size_t i = 0; i < count; ++i) {
+        const sf_vec3 p = vertices[i].position;
+        box.min = (sf_vec3){fminf(box.min.x, p.x), fminf(box.min.y, p.y), fminf(box.min.z, p.z)};
+        box.max = (sf_vec3){fmaxf(box.max.x, p.x), fmaxf(box.max.y, p.y), fmaxf(box.max.z, p.z)};
+    }
+
+    const sf_vec3 center = {(box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f};
+    float radius = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        const sf_vec3 p = vertices[i].position;
+        const float x = p.x - center.x, y = p.y - center.y, z = p.z - center.z;
+        radius = fmaxf(radius, x * x + y * y + z * z);
+    }
+    return (sf_bounds){box, {center, sqrtf(radius)}};
+}
+
+sf_aabb sf_aabb_transform(const sf_aabb box, const mat4 model) {
+    // Transform the center, and grow the extents by the absolute value of each axis of the matrix (Arvo).
+    const float c[3] = {(box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f};
+    const float e[3] = {(box.max.x - box.min.x) * 0.5f, (box.max.y - box.min.y) * 0.5f, (box.max.z - box.min.z) * 0.5f};
+    float center[3], extent[3];
+    for (int r = 0; r < 3; ++r) {
+        center[r] = model[3][r];
+        extent[r] = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            center[r] += model[k][r] * c[k];
+            extent[r] += fabsf(model[k][r]) * e[k];
+        }
+    }
+    return (sf_aabb){
+        {center[0] - extent[0], center[1] - extent[1], center[2] - extent[2]},
+        {center[0] + extent[0], center[1] + extent[1], center[2] + extent[2]},
+    };
+}
+
+sf_sphere sf_sphere_transform(const sf_sphere sphere, const mat4 model) {
+    const sf_vec3 c = sphere.center;
+    const float scale = fmaxf(fmaxf(
+        model[0][0] * model[0][0] + model[0][1] * model[0][1] + model[0][2] * model[0][2],
+        model[1][0] * model[1][0] + model[1][1] * model[1][1] + model[1][2] * model[1][2]),
+        model[2][0] * model[2][0] + model[2][1] * model[2][1] + model[2][2] * model[2][2]);
+    return (sf_sphere){
+        {
+            model[0][0] * c.x + model[1][0] * c.y + model[2][0] * c.z + model[3][0],
+            model[0][1] * c.x + model[1][1] * c.y + model[2][1] * c.z + model[3][1],
+            model[0][2] * c.x + model[1][2] * c.y + model[2][2] * c.z + model[3][2],
+        },
+        sphere.radius * sqrtf(scale),
+    };
+}
+
+void sf_frustum_extract(sf_frustum *out, const mat4 projection, const mat4 view) {
+    // Gribb and Hartmann: every plane is the last row of the clip matrix plus or minus one of the others.
+    mat4 clip;
+    glm_mat4_mul((vec4 *)projection, (vec4 *)view, clip);
+    for (int i = 0; i < 6; ++i) {
+        const int row = i / 2;
+        const float sign = i % 2 ? -1.0f : 1.0f;
+        for (int c = 0; c < 4; ++c)
+            out->planes[i][c] = clip[c][3] + sign * clip[c][row];
+        const float length = sqrtf(out->planes[i][0] * out->planes[i][0] + out->planes[i][1] * out->planes[i][1] + out->planes[i][2] * out->planes[i][2]);
+        if (length > 0.0f)
+            for (int c = 0; c < 4; ++c)
+                out->planes[i][c] /= length;
+    }
+}
+
+// Batched culling kernel.
+// Spheres are transposed into one register per component, so each plane is tested against
+// four (or eight with AVX2) spheres with three multiplies, and the lanes left inside every plane are written out.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SF_CULL_LANES 4
+
+/// Load four spheres as one register each of x, y, z and radius.
+static inline void sf_cull_load(const sf_sphere *spheres, __m128 *x, __m128 *y, __m128 *z, __m128 *r) {
+    __m128 a = _mm_loadu_ps(&spheres[0].center.x), b = _mm_loadu_ps(&spheres[1].center.x);
+    __m128 c = _mm_loadu_ps(&spheres[2].center.x), d = _mm_loadu_ps(&spheres[3].center.x);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    *x = a; *y = b; *z = c; *r = d;
+}
+#endif
+
+#if SF_AVX2
+#include <immintrin.h>
+
+/// Cull spheres eight at a time, returning how many were written. Stops at the last full group of eight, at *next.
+SF_TARGET_AVX2 static size_t sf_frustum_cull_avx2(const sf_frustum *frustum, const sf_sphere *spheres, const size_t count,
+    uint32_t *visible, size_t *next) {
+    size_t written = 0, i = 0;
+    __m256 planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm256_set1_ps(frustum->planes[p][c]);
+    for (; i + 8 <= count; i += 8) {
+        __m128 x0, y0, z0, r0, x1, y1, z1, r1;
+        sf_cull_load(spheres + i, &x0, &y0, &z0, &r0);
+        sf_cull_load(spheres + i + 4, &x1, &y1, &z1, &r1);
+        const __m256 x = _mm256_set_m128(x1, x0), y = _mm256_set_m128(y1, y0), z = _mm256_set_m128(z1, z0);
+        const __m256 r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_set_m128(r1, r0));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, r, _CMP_GE_OQ));
+        }
+        const unsigned mask = (unsigned)_mm256_movemask_ps(inside);
+        for (unsigned k = 0; k < 8; ++k) {
+            visible[written] = (uint32_t)(i + k);
+            written += (mask >> k) & 1;
+        }
+    }
+    *next = i;
+    return written;
+}
+#endif
+
+size_t sf_frustum_cull(const sf_frustum *frustum, const sf_sphere *spheres, const size_t count, uint32_t *visible) {
+    size_t written = 0, i = 0;
+#if SF_AVX2
+    if (sf_cpu_avx2())
+        written = sf_frustum_cull_avx2(frustum, spheres, count, visible, &i);
+#endif
+#if defined(__SSE2__)
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm_set1_ps(frustum->planes[p][c]);
+    for (; i + SF_CULL_LANES <= count; i += SF_CULL_LANES) {
+        __m128 x, y, z, r;
+        sf_cull_load(spheres + i, &x, &y, &z, &r);
+        r = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, r));
+        }
+        const unsigned mask = (unsigned)_mm_movemask_ps(inside);
+        for (unsigned k = 0; k < SF_CULL_LANES; ++k) {
+            visible[written] = (uint32_t)(i + k);
+            written += (mask >> k) & 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        visible[written] = (uint32_t)i;
+        written += sf_frustum_test_sphere(frustum, spheres[i]);
+    }
+    return written;
+}
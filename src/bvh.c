@@ -0,0 +1,421 @@
+#include "sf/bvh.h"
+#include "util.h"
+
+static sf_aabb sf_bvh_fatten(const sf_aabb box, const float margin) {
+    return (sf_aabb){
+        {box.min.x - margin, box.min.y - margin, box.min.z - margin},
+        {box.max.x + margin, box.max.y + margin, box.max.z + margin},
+    };
+}
+
+/// Grow the node array to hold at least capacity nodes.
+static void sf_bvh_expand(sf_bvh *bvh, const size_t capacity) {
+    const size_t old = bvh->capacity;
+    size_t grown = old ? old : 16;
+    while (grown < capacity)
+        grown *= 2;
+    if (grown == old)
+        return;
+    bvh->nodes = sf_grow(bvh->nodes, grown * sizeof(sf_bvh_node));
+    // New nodes go on the front of the free list in order, so a fresh tree hands out handles 0, 1, 2...
+    for (size_t i = old; i < grown; ++i) {
+        bvh->nodes[i].parent = i + 1 < grown ? (int32_t)(i + 1) : bvh->free_node;
+        bvh->nodes[i].height = -1;
+    }
+    bvh->free_node = (int32_t)old;
+    bvh->capacity = grown;
+}
+
+static int32_t sf_bvh_allocate(sf_bvh *bvh) {
+    if (bvh->free_node == SF_BVH_NONE)
+        sf_bvh_expand(bvh, bvh->capacity * 2);
+    const int32_t node = bvh->free_node;
+    bvh->free_node = bvh->nodes[node].parent;
+    bvh->nodes[node] = (sf_bvh_node){ .parent = SF_BVH_NONE, .left = SF_BVH_NONE, .right = SF_BVH_NONE };
+    return node;
+}
+
+static void sf_bvh_release(sf_bvh *bvh, const int32_t node) {
+    bvh->nodes[node].parent = bvh->free_node;
+    bvh->nodes[node].height = -1;
+    bvh->free_node = node;
+}
+
+static void sf_bvh_push(sf_bvh *bvh, size_t *top, const int32_t value) {
+    if (*top == bvh->stack_capacity) {
+        bvh->stack_capacity = bvh->stack_capacity ? bvh->stack_capacity * 2 : 64;
+        bvh->stack = sf_grow(bvh->stack, bvh->stack_capacity * sizeof(int32_t));
+    }
+    bvh->stack[(*top)++] = value;
+}
+
+sf_bvh sf_bvh_new(const float margin) {
+    return (sf_bvh){
+        .root = SF_BVH_NONE,
+        .free_node = SF_BVH_NONE,
+        .margin = margin,
+    };
+}
+
+void sf_bvh_delete(sf_bvh *bvh) {
+    free(bvh->nodes);
+    free(bvh->stack);
+    *bvh = (sf_bvh){ .root = SF_BVH_NONE, .free_node = SF_BVH_NONE };
+}
+
+/// Point a node's parent, or the root, at a new child in its place.
+static void sf_bvh_replace_child(sf_bvh *bvh, const int32_t parent, const int32_t old, const int32_t child) {
+    if (parent == SF_BVH_NONE)
+        bvh->root = child;
+    else if (bvh->nodes[parent].left == old)
+        bvh->nodes[parent].left = child;
+    else bvh->nodes[parent].right = child;
+}
+
+/// Rotate the taller grandchild of a up if its children's heights differ by more than one, returning the subtree's new root.
+static int32_t sf_bvh_balance(sf_bvh *bvh, const int32_t a) {
+    sf_bvh_node *n = bvh->nodes;
+    if (n[a].left == SF_BVH_NONE || n[a].height < 2)
+        return a;
+
+    const int32_t b = n[a].left, c = n[a].right;
+    const int32_t balance = n[c].height - n[b].height;
+    if (balance > 1) {
+        const int32_t f = n[c].left, g = n[c].right;
+        n[c].left = a;
+        n[c].parent = n[a].parent;
+        n[a].parent = c;
+        sf_bvh_replace_child(bvh, n[c].parent, a, c);
+        // The taller of c's children stays with c, the other one goes to a.
+        const int32_t keep = n[f].height > n[g].height ? f : g, move = keep == f ? g : f;
+        n[c].right = keep;
+        n[a].right = move;
+        n[move].parent = a;
+        n[a].box = sf_aabb_union(n[b].box, n[move].box);
+        n[c].box = sf_aabb_union(n[a].box, n[keep].box);
+        n[a].height = 1 + (n[b].height > n[move].height ? n[b].height : n[move].height);
+        n[c].height = 1 + (n[a].height > n[keep].height ? n[a].height : n[keep].height);
+        return c;
+    }
+    if (balance < -1) {
+        const int32_t d = n[b].left, e = n[b].right;
+        n[b].left = a;
+        n[b].parent = n[a].parent;
+        n[a].parent = b;
+        sf_bvh_replace_child(bvh, n[b].parent, a, b);
+        const int32_t keep = n[d].height > n[e].height ? d : e, move = keep == d ? e : d;
+        n[b].right = keep;
+        n[a].left = move;
+        n[move].parent = a;
+        n[a].box = sf_aabb_union(n[c].box, n[move].box);
+        n[b].box = sf_aabb_union(n[a].box, n[keep].box);
+        n[a].height = 1 + (n[c].height > n[move].height ? n[c].height : n[move].height);
+        n[b].height = 1 + (n[a].height > n[keep].height ? n[a].height : n[keep].height);
+        return b;
+    }
+    return a;
+}
+
+/// Fix the boxes and heights of every ancestor from node up, rebalancing on the way.
+static void sf_bvh_fix_upwards(sf_bvh *bvh, int32_t node) {
+    while (node != SF_BVH_NONE) {
+        node = sf_bvh_balance(bvh, node);
+        sf_bvh_node *n = bvh->nodes;
+        const int32_t left = n[node].left, right = n[node].right;
+        n[node].height = 1 + (n[left].height > n[right].height ? n[left].height : n[right].height);
+        n[node].box = sf_aabb_union(n[left].box, n[right].box);
+        node = n[node].parent;
+    }
+}
+
+/// Find the node whose pairing with a box adds the least surface area to the tree, descending while it pays off.
+static int32_t sf_bvh_find_sibling(const sf_bvh *bvh, const sf_aabb box) {
+    const sf_bvh_node *n = bvh->nodes;
+    int32_t index = bvh->root;
+    while (n[index].left != SF_BVH_NONE) {
+        const float area = sf_aabb_area(n[index].box);
+        const float combined = sf_aabb_area(sf_aabb_union(n[index].box, box));
+        // Pairing with this node creates a parent with the combined box.
+        const float cost = 2.0f * combined;
+        // Descending grows this node's box anyway, which every deeper option pays for.
+        const float inherited = 2.0f * (combined - area);
+
+        float child_cost[2];
+        const int32_t children[2] = {n[index].left, n[index].right};
+        for (int i = 0; i < 2; ++i) {
+            const sf_aabb child = n[children[i]].box;
+            const float grown = sf_aabb_area(sf_aabb_union(child, box));
+            child_cost[i] = (n[children[i]].left == SF_BVH_NONE ? grown : grown - sf_aabb_area(child)) + inherited;
+        }
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+        index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+    }
+    return index;
+}
+
+static void sf_bvh_insert_leaf(sf_bvh *bvh, const int32_t leaf) {
+    if (bvh->root == SF_BVH_NONE) {
+        bvh->root = leaf;
+        bvh->nodes[leaf].parent = SF_BVH_NONE;
+        return;
+    }
+
+    const int32_t sibling = sf_bvh_find_sibling(bvh, bvh->nodes[leaf].box);
+    const int32_t parent = sf_bvh_allocate(bvh);
+    sf_bvh_node *n = bvh->nodes;
+    const int32_t grandparent = n[sibling].parent;
+    n[parent].parent = grandparent;
+    n[parent].left = sibling;
+    n[parent].right = leaf;
+    n[parent].box = sf_aabb_union(n[sibling].box, n[leaf].box);
+    n[parent].height = n[sibling].height + 1;
+    sf_bvh_replace_child(bvh, grandparent, sibling, parent);
+    n[sibling].parent = parent;
+    n[leaf].parent = parent;
+    sf_bvh_fix_upwards(bvh, grandparent);
+}
+
+static void sf_bvh_remove_leaf(sf_bvh *bvh, const int32_t leaf) {
+    if (leaf == bvh->root) {
+        bvh->root = SF_BVH_NONE;
+        return;
+    }
+
+    sf_bvh_node *n = bvh->nodes;
+    const int32_t parent = n[leaf].parent, grandparent = n[parent].parent;
+    const int32_t sibling = n[parent].left == leaf ? n[parent].right : n[parent].left;
+    sf_bvh_replace_child(bvh, grandparent, parent, sibling);
+    n[sibling].parent = grandparent;
+    sf_bvh_release(bvh, parent);
+    sf_bvh_fix_upwards(bvh, grandparent);
+}
+
+sf_bvh_handle sf_bvh_insert(sf_bvh *bvh, const sf_aabb box, const uint32_t user) {
+    const int32_t leaf = sf_bvh_allocate(bvh);
+    bvh->nodes[leaf].box = sf_bvh_fatten(box, bvh->margin);
+    bvh->nodes[leaf].object = box;
+    bvh->nodes[leaf].user = user;
+    sf_bvh_insert_leaf(bvh, leaf);
+    bvh->count++;
+    return leaf;
+}
+
+void sf_bvh_remove(sf_bvh *bvh, const sf_bvh_handle handle) {
+    sf_bvh_remove_leaf(bvh, handle);
+    sf_bvh_release(bvh, handle);
+    bvh->count--;
+}
+
+bool sf_bvh_move(sf_bvh *bvh, const sf_bvh_handle handle, const sf_aabb box) {
+    sf_bvh_node *leaf = &bvh->nodes[handle];
+    leaf->object = box;
+    // Objects that shrank a lot are reinserted too, or their stale fat box keeps overlapping everything around it.
+    if (sf_aabb_contains(leaf->box, box) && sf_aabb_contains(sf_bvh_fatten(box, bvh->margin * 4.0f), leaf->box))
+        return false;
+
+    sf_bvh_remove_leaf(bvh, handle);
+    bvh->nodes[handle].box = sf_bvh_fatten(box, bvh->margin);
+    sf_bvh_insert_leaf(bvh, handle);
+    return true;
+}
+
+void sf_bvh_update(sf_bvh *bvh, const sf_bvh_handle handle, const sf_aabb box) {
+    bvh->nodes[handle].object = box;
+    bvh->nodes[handle].box = sf_bvh_fatten(box, bvh->margin);
+}
+
+void sf_bvh_refit(sf_bvh *bvh) {
+    if (bvh->root == SF_BVH_NONE)
+        return;
+    // Nodes in preorder come after their parents, so walking the order backwards visits children first.
+    size_t top = 0, order = 0;
+    sf_bvh_push(bvh, &top, bvh->root);
+    while (order < top) {
+        const sf_bvh_node *node = &bvh->nodes[bvh->stack[order++]];
+        if (node->left != SF_BVH_NONE) {
+            const int32_t left = node->left, right = node->right;
+            sf_bvh_push(bvh, &top, left);
+            sf_bvh_push(bvh, &top, right);
+        }
+    }
+    sf_bvh_node *n = bvh->nodes;
+    for (size_t i = top; i-- > 0;) {
+        sf_bvh_node *node = &n[bvh->stack[i]];
+        if (node->left != SF_BVH_NONE)
+            node->box = sf_aabb_union(n[node->left].box, n[node->right].box);
+    }
+}
+
+static float sf_bvh_centroid(const sf_bvh *bvh, const int32_t leaf, const int axis) {
+    const sf_aabb *box = &bvh->nodes[leaf].box;
+    switch (axis) {
+        case 0: return box->min.x + box->max.x;
+        case 1: return box->min.y + box->max.y;
+        default: return box->min.z + box->max.z;
+    }
+}
+
+/// Partially sort leaves so the k-th one by centroid along axis is in place, with smaller ones before it.
+static void sf_bvh_select(const sf_bvh *bvh, int32_t *leaves, const size_t count, const size_t k, const int axis) {
+    int64_t lo = 0, hi = (int64_t)count - 1;
+    while (lo < hi) {
+        const float pivot = sf_bvh_centroid(bvh, leaves[lo + (hi - lo) / 2], axis);
+        int64_t i = lo, j = hi;
+        while (i <= j) {
+            while (sf_bvh_centroid(bvh, leaves[i], axis) < pivot)
+                i++;
+            while (sf_bvh_centroid(bvh, leaves[j], axis) > pivot)
+                j--;
+            if (i <= j) {
+                const int32_t swap = leaves[i];
+                leaves[i++] = leaves[j];
+                leaves[j--] = swap;
+            }
+        }
+        if ((int64_t)k <= j)
+            hi = j;
+        else if ((int64_t)k >= i)
+            lo = i;
+        else return;
+    }
+}
+
+static int32_t sf_bvh_build_range(sf_bvh *bvh, int32_t *leaves, const size_t count) {
+    if (count == 1)
+        return leaves[0];
+
+    float min[3] = {INFINITY, INFINITY, INFINITY}, max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t i = 0; i < count; ++i)
+        for (int axis = 0; axis < 3; ++axis) {
+            const float c = sf_bvh_centroid(bvh, leaves[i], axis);
+            min[axis] = fminf(min[axis], c);
+            max[axis] = fmaxf(max[axis], c);
+        }
+    int axis = 0;
+    for (int i = 1; i < 3; ++i)
+        if (max[i] - min[i] > max[axis] - min[axis])
+            axis = i;
+
+    const size_t mid = count / 2;
+    sf_bvh_select(bvh, leaves, count, mid, axis);
+    const int32_t left = sf_bvh_build_range(bvh, leaves, mid);
+    const int32_t right = sf_bvh_build_range(bvh, leaves + mid, count - mid);
+
+    const int32_t node = sf_bvh_allocate(bvh);
+    sf_bvh_node *n = bvh->nodes;
+    n[node].left = left;
+    n[node].right = right;
+    n[node].box = sf_aabb_union(n[left].box, n[right].box);
+    n[node].height = 1 + (n[left].height > n[right].height ? n[left].height : n[right].height);
+    n[left].parent = node;
+    n[right].parent = node;
+    return node;
+}
+
+void sf_bvh_build(sf_bvh *bvh, const sf_aabb *boxes, const uint32_t *users, const size_t count, sf_bvh_handle *out) {
+    const float margin = bvh->margin;
+    free(bvh->nodes);
+    free(bvh->stack);
+    *bvh = sf_bvh_new(margin);
+    if (count == 0)
+        return;
+
+    sf_bvh_expand(bvh, count * 2 - 1);
+    int32_t *leaves = sf_malloc(count * sizeof(int32_t));
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t leaf = sf_bvh_allocate(bvh);
+        bvh->nodes[leaf].box = sf_bvh_fatten(boxes[i], margin);
+        bvh->nodes[leaf].object = boxes[i];
+        bvh->nodes[leaf].user = users ? users[i] : (uint32_t)i;
+        leaves[i] = out[i] = leaf;
+    }
+    bvh->count = count;
+    bvh->root = sf_bvh_build_range(bvh, leaves, count);
+    free(leaves);
+}
+
+/// Test a box against the planes in mask. Returns false if it's outside one of them,
+/// and clears the planes it's entirely inside of from mask, children don't need to test those again.
+static bool sf_bvh_frustum_test(const sf_frustum *frustum, const sf_aabb *box, uint32_t *mask) {
+    for (int i = 0; i < 6; ++i) {
+        if (!(*mask & (1u << i)))
+            continue;
+        const float *p = frustum->planes[i];
+        // The corner furthest along the plane's normal, then the one furthest against it.
+        const float far = p[0] * (p[0] >= 0.0f ? box->max.x : box->min.x)
+            + p[1] * (p[1] >= 0.0f ? box->max.y : box->min.y)
+            + p[2] * (p[2] >= 0.0f ? box->max.z : box->min.z) + p[3];
+        if (far < 0.0f)
+            return false;
+        const float near = p[0] * (p[0] >= 0.0f ? box->min.x : box->max.x)
+            + p[1] * (p[1] >= 0.0f ? box->min.y : box->max.y)
+            + p[2] * (p[2] >= 0.0f ? box->min.z : box->max.z) + p[3];
+        if (near >= 0.0f)
+            *mask &= ~(1u << i);
+    }
+    return true;
+}
+
+size_t sf_bvh_query_frustum(sf_bvh *bvh, const sf_frustum *frustum, sf_vec *out) {
+    if (bvh->root == SF_BVH_NONE)
+        return 0;
+    size_t found = 0, top = 0;
+    // The stack holds pairs of a node and the planes it still has to be tested against.
+    sf_bvh_push(bvh, &top, bvh->root);
+    sf_bvh_push(bvh, &top, 0x3F);
+    while (top) {
+        uint32_t mask = (uint32_t)bvh->stack[--top];
+        const int32_t index = bvh->stack[--top];
+        const sf_bvh_node *node = &bvh->nodes[index];
+        const bool leaf = node->left == SF_BVH_NONE;
+        if (mask && !sf_bvh_frustum_test(frustum, leaf ? &node->object : &node->box, &mask))
+            continue;
+        if (leaf) {
+            sf_vec_push(out, &node->user);
+            found++;
+            continue;
+        }
+        const int32_t left = node->left, right = node->right;
+        sf_bvh_push(bvh, &top, right);
+        sf_bvh_push(bvh, &top, (int32_t)mask);
+        sf_bvh_push(bvh, &top, left);
+        sf_bvh_push(bvh, &top, (int32_t)mask);
+    }
+    return found;
+}
+
+bool sf_bvh_raycast(sf_bvh *bvh, const sf_ray ray, const float max_distance, sf_bvh_hit *hit) {
+    const sf_vec3 inverse = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    float best = max_distance, distance;
+    *hit = (sf_bvh_hit){ .handle = SF_BVH_NONE, .distance = max_distance };
+    if (bvh->root == SF_BVH_NONE || !sf_ray_aabb(ray, inverse, bvh->nodes[bvh->root].box, best, &distance))
+        return false;
+
+    size_t top = 0;
+    sf_bvh_push(bvh, &top, bvh->root);
+    while (top) {
+        const sf_bvh_node *node = &bvh->nodes[bvh->stack[--top]];
+        if (node->left == SF_BVH_NONE) {
+            if (sf_ray_aabb(ray, inverse, node->object, best, &distance) && distance < best) {
+                best = distance;
+                *hit = (sf_bvh_hit){ (sf_bvh_handle)(node - bvh->nodes), node->user, distance };
+            }
+            continue;
+        }
+        // Visit the nearer child first, so the furthest one is likely pruned by then.
+        const int32_t left = node->left, right = node->right;
+        float left_distance, right_distance;
+        const bool left_hit = sf_ray_aabb(ray, inverse, bvh->nodes[left].box, best, &left_distance);
+        const bool right_hit = sf_ray_aabb(ray, inverse, bvh->nodes[right].box, best, &right_distance);
+        if (left_hit && right_hit) {
+            const bool left_first = left_distance <= right_distance;
+            sf_bvh_push(bvh, &top, left_first ? right : left);
+            sf_bvh_push(bvh, &top, left_first ? left : right);
+        } else if (left_hit)
+            sf_bvh_push(bvh, &top, left);
+        else if (right_hit)
+            sf_bvh_push(bvh, &top, right);
+    }
+    return hit->handle != SF_BVH_NONE;
+}
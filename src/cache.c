@@ -0,0 +1,185 @@
+#ifndef _WIN32
+// realpath is POSIX, not C.
+#    define _XOPEN_SOURCE 700
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sf/fs.h>
+#include "sf/cache.h"
+
+/// The absolute path to a file with links and dots resolved, or a copy of path if it doesn't exist.
+static sf_str sf_canonical_path(const sf_str path) {
+#ifdef _WIN32
+    char *full = _fullpath(nullptr, path.c_str, 0);
+#else
+    char *full = realpath(path.c_str, nullptr);
+#endif
+    if (!full)
+        return sf_str_dup(path);
+    const sf_str out = sf_str_cdup(full);
+    free(full);
+    return out;
+}
+
+static uint64_t sf_path_hash(const sf_str path) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < path.len; ++i) {
+        hash ^= (uint8_t)path.c_str[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/// Hash a file's contents eight bytes at a time, textures are big enough that a bytewise hash shows up next to decoding.
+static uint64_t sf_content_hash(const uint8_t *data, const size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i)
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+sf_texture_cache sf_texture_cache_new(const size_t budget) {
+    return (sf_texture_cache){
+        .textures = sf_vec_new(sf_cached_texture *),
+        .paths = sf_vec_new(sf_cached_path),
+        .budget = budget ? budget : SF_TEXTURE_CACHE_BUDGET,
+    };
+}
+
+void sf_texture_cache_delete(sf_texture_cache *cache) {
+    sf_cached_texture **textures = cache->textures.data;
+    for (size_t i = 0; i < cache->textures.count; ++i) {
+        sf_texture_delete(&textures[i]->texture);
+        free(textures[i]);
+    }
+    sf_cached_path *paths = cache->paths.data;
+    for (size_t i = 0; i < cache->paths.count; ++i)
+        sf_str_free(paths[i].path);
+    sf_vec_delete(&cache->textures);
+    sf_vec_delete(&cache->paths);
+    *cache = (sf_texture_cache){};
+}
+
+/// Hand out a reference to a cached texture.
+static sf_cached_texture *sf_texture_cache_hit(sf_texture_cache *cache, sf_cached_texture *texture) {
+    cache->stats.hits++;
+    texture->used = ++cache->tick;
+    return sf_texture_cache_retain(texture);
+}
+
+sf_result sf_texture_cache_load(sf_texture_cache *cache, const sf_str path, sf_cached_texture **out) {
+    *out = nullptr;
+    const sf_str canonical = sf_canonical_path(path);
+    const uint64_t path_hash = sf_path_hash(canonical);
+    const sf_cached_path *paths = cache->paths.data;
+    for (size_t i = 0; i < cache->paths.count; ++i)
+        if (paths[i].hash == path_hash && paths[i].path.len == canonical.len
+            && memcmp(paths[i].path.c_str, canonical.c_str, canonical.len) == 0) {
+            sf_str_free(canonical);
+            *out = sf_texture_cache_hit(cache, paths[i].texture);
+            return sf_ok();
+        }
+
+    const long size = sf_file_exists(canonical) ? sf_file_size(canonical) : 0;
+    if (size <= 0) {
+        sf_str_free(canonical);
+        return sf_err(sf_str_fmt("File '%s' does not exist.", path.c_str));
+    }
+    uint8_t *data = sf_malloc((size_t)size);
+    sf_result res = sf_load_file(data, canonical);
+    if (!res.ok) {
+        free(data);
+        sf_str_free(canonical);
+        return res;
+    }
+
+    // A new path to a file we already have, such as a copy of a shared atlas.
+    const uint64_t content_hash = sf_content_hash(data, (size_t)size);
+    sf_cached_texture **textures = cache->textures.data;
+    for (size_t i = 0; i < cache->textures.count; ++i)
+        if (textures[i]->content_hash == content_hash && textures[i]->file_size == (size_t)size) {
+            *out = sf_texture_cache_hit(cache, textures[i]);
+            break;
+        }
+
+    if (!*out) {
+        sf_texture texture;
+        res = sf_texture_load_memory(&texture, data, (size_t)size);
+        if (!res.ok) {
+            free(data);
+            sf_str_free(canonical);
+            const sf_str err = sf_str_fmt("File '%s' could not be loaded: %s", path.c_str, res.err.c_str);
+            sf_str_free(res.err);
+            return sf_err(err);
+        }
+
+        sf_cached_texture *cached = sf_malloc(sizeof(sf_cached_texture));
+        *cached = (sf_cached_texture){
+            .texture = texture,
+            .content_hash = content_hash,
+            .file_size = (size_t)size,
+            .bytes = sf_texture_bytes(&texture),
+            .refs = 1,
+            .used = ++cache->tick,
+        };
+        sf_vec_push(&cache->textures, &cached);
+        cache->stats.misses++;
+        cache->stats.resident += cached->bytes;
+        *out = cached;
+    }
+    free(data);
+
+    const sf_cached_path alias = {canonical, path_hash, *out};
+    sf_vec_push(&cache->paths, &alias);
+    sf_texture_cache_trim(cache);
+    return sf_ok();
+}
+
+void sf_texture_cache_release(sf_texture_cache *cache, sf_cached_texture *texture) {
+    if (texture->refs == 0)
+        return;
+    if (--texture->refs == 0)
+        sf_texture_cache_trim(cache);
+}
+
+/// Free a texture and every path that resolves to it.
+static void sf_texture_cache_evict(sf_texture_cache *cache, const size_t index) {
+    sf_cached_texture **textures = cache->textures.data;
+    sf_cached_texture *texture = textures[index];
+    sf_cached_path *paths = cache->paths.data;
+    for (size_t i = 0; i < cache->paths.count;) {
+        if (paths[i].texture == texture) {
+            sf_str_free(paths[i].path);
+            paths[i] = paths[--cache->paths.count];
+            continue;
+        }
+        i++;
+    }
+
+    cache->stats.resident -= texture->bytes;
+    cache->stats.evictions++;
+    sf_texture_delete(&texture->texture);
+    free(texture);
+    textures[index] = textures[--cache->textures.count];
+}
+
+void sf_texture_cache_trim(sf_texture_cache *cache) {
+    while (cache->stats.resident > cache->budget) {
+        sf_cached_texture **textures = cache->textures.data;
+        size_t oldest = SIZE_MAX;
+        for (size_t i = 0; i < cache->textures.count; ++i)
+            if (textures[i]->refs == 0 && (oldest == SIZE_MAX || textures[i]->used < textures[oldest]->used))
+                oldest = i;
+        if (oldest == SIZE_MAX)
+            return;
+        sf_texture_cache_evict(cache, oldest);
+    }
+}
@@ -1,5 +1,16 @@
+#include <string.h>
 #include "sf/camera.h"
 #include "sf/shaders.h"
+#include "sf/state.h"
+#include "sf/meshes.h"
+#include "sf/stream.h"
+
+static sf_camera sf_render_default = {
+    .type = SF_CAMERA_RENDER_DEFAULT,
+    .transform = SF_TRANSFORM_IDENTITY,
+    .framebuffer = 0,
+};
+sf_camera *const SF_RENDER_DEFAULT = &sf_render_default;
 
 sf_camera sf_camera_new(const sf_camera_type type, const float fov, const float near, const float far) {
     return (sf_camera){
@@ -13,11 +24,88 @@ sf_camera sf_camera_new(const sf_camera_type type, const float fov, const float
 }
 
 void sf_camera_delete(sf_camera *camera) {
+    if (camera->ubo != 0) {
+        sf_gl_forget_buffer(camera->ubo);
+        glDeleteBuffers(1, &camera->ubo);
+        camera->ubo = 0;
+    }
     if (camera->framebuffer != 0) {
+        sf_gl_forget_framebuffer(camera->framebuffer);
         glDeleteFramebuffers(1, &camera->framebuffer);
-        sf_texture_delete(&camera->fb_color);
-        sf_texture_delete(&camera->fb_stencil);
+        camera->framebuffer = 0;
+    }
+    if (camera->targets) {
+        sf_target_release(camera->targets, &camera->fb_color);
+        sf_target_release(camera->targets, &camera->fb_stencil);
+        camera->targets = nullptr;
+    }
+}
+
+/// The uniform buffer a camera's block lives in. SF_RENDER_DEFAULT is drawn with in every context, so it has one per context.
+static GLuint *sf_camera_buffer(sf_camera *camera) {
+    return camera == &sf_render_default ? &sf_gl_state_current()->default_camera : &camera->ubo;
+}
+
+void sf_camera_refresh(sf_camera *camera) {
+    sf_camera_block block;
+    if (camera->type == SF_CAMERA_RENDER_DEFAULT)
+        glm_mat4_identity(block.projection);
+    else
+        glm_mat4_copy(camera->projection, block.projection);
+
+    sf_transform cp = camera->transform;
+    cp.position = (sf_vec3){-cp.position.x, -cp.position.y, -cp.position.z};
+    sf_transform_model(block.campos, cp);
+
+    // The view depends on the camera's parents too, so the whole block is compared rather than the transform.
+    if (memcmp(&block, &camera->block, sizeof(sf_camera_block)) == 0)
+        return;
+    camera->block = block;
+    camera->stale = true;
+    sf_frustum_extract(&camera->frustum, block.projection, block.campos);
+}
+
+void sf_camera_update(sf_camera *camera) {
+    sf_camera_refresh(camera);
+    GLuint *ubo = sf_camera_buffer(camera);
+    if (*ubo == 0) {
+        glGenBuffers(1, ubo);
+        sf_gl_bind_buffer(GL_UNIFORM_BUFFER, *ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(sf_camera_block), &camera->block, GL_DYNAMIC_DRAW);
+    } else if (camera->stale) {
+        sf_gl_bind_buffer(GL_UNIFORM_BUFFER, *ubo);
+        sf_stream *stream = sf_stream_current();
+        if (!stream || !sf_stream_copy(stream, GL_UNIFORM_BUFFER, 0, &camera->block, sizeof(sf_camera_block)))
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(sf_camera_block), &camera->block);
     }
+    camera->stale = false;
+}
+
+sf_result sf_camera_bind(const sf_camera *camera) {
+    const GLuint ubo = camera == &sf_render_default ? sf_gl_state_current()->default_camera : camera->ubo;
+    if (ubo == 0)
+        return sf_err(sf_lit("Camera was bound before its first update."));
+    sf_gl_bind_buffer_base(GL_UNIFORM_BUFFER, SF_CAMERA_BINDING, ubo);
+    return sf_ok();
+}
+
+sf_ray sf_camera_ray(sf_camera *camera, const sf_vec2 point, const sf_vec2 size) {
+    sf_camera_refresh(camera);
+    mat4 clip, inverse;
+    glm_mat4_mul((vec4 *)camera->block.projection, (vec4 *)camera->block.campos, clip);
+    glm_mat4_inv(clip, inverse);
+
+    // Unproject the point on the near and far planes, the ray runs from one to the other.
+    const float x = point.x / size.x * 2.0f - 1.0f, y = 1.0f - point.y / size.y * 2.0f;
+    vec4 near = {x, y, -1.0f, 1.0f}, far = {x, y, 1.0f, 1.0f};
+    glm_mat4_mulv(inverse, near, near);
+    glm_mat4_mulv(inverse, far, far);
+    glm_vec4_scale(near, 1.0f / near[3], near);
+    glm_vec4_scale(far, 1.0f / far[3], far);
+
+    vec3 direction = {far[0] - near[0], far[1] - near[1], far[2] - near[2]};
+    glm_vec3_normalize(direction);
+    return (sf_ray){{near[0], near[1], near[2]}, {direction[0], direction[1], direction[2]}};
 }
 
 sf_vec3 sf_camera_right(const sf_camera *camera) {
@@ -0,0 +1,128 @@
+#include "sf/context.h"
+#include "sf/state.h"
+
+#ifdef SF_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/// Find a display that doesn't need a window system.
+/// Mesa's surfaceless platform is preferred, it works without a GPU or any device nodes.
+static EGLDisplay sf_egl_display() {
+    const PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        const EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY)
+            return display;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+sf_result sf_context_new(sf_context *out, const sf_vec2 size) {
+    *out = (sf_context){ .size = size };
+
+    const EGLDisplay display = sf_egl_display();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        return sf_err(sf_lit("EGL Failed to initialize."));
+    out->display = display;
+
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")) {
+        sf_context_delete(out);
+        return sf_err(sf_lit("EGL doesn't support surfaceless contexts."));
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        sf_context_delete(out);
+        return sf_err(sf_lit("EGL doesn't support desktop OpenGL."));
+    }
+
+    // The context never draws to an EGL surface, any OpenGL capable config will do.
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint config_count = 0;
+    eglChooseConfig(display, (EGLint[]){
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE,
+    }, &config, 1, &config_count);
+    if (config_count == 0)
+        config = EGL_NO_CONFIG_KHR;
+
+    out->context = eglCreateContext(display, config, EGL_NO_CONTEXT, (EGLint[]){
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    });
+    if (out->context == EGL_NO_CONTEXT) {
+        sf_context_delete(out);
+        return sf_err(sf_str_fmt("EGL Failed to create an OpenGL 3.3 context (0x%x).", eglGetError()));
+    }
+
+    sf_context_make_current(out);
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        sf_context_delete(out);
+        return sf_err(sf_lit("GLAD Failed to initialize!"));
+    }
+
+    glGenFramebuffers(1, &out->framebuffer);
+    glGenRenderbuffers(1, &out->color);
+    glGenRenderbuffers(1, &out->depth_stencil);
+    sf_context_resize(out, size);
+
+    sf_gl_bind_framebuffer(out->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, out->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, out->depth_stencil);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        sf_context_delete(out);
+        return sf_err(sf_lit("The headless framebuffer is incomplete."));
+    }
+
+    return sf_ok();
+}
+
+void sf_context_delete(sf_context *context) {
+    if (context->context) {
+        sf_context_make_current(context);
+        if (context->framebuffer) {
+            glDeleteFramebuffers(1, &context->framebuffer);
+            sf_gl_forget_framebuffer(context->framebuffer);
+        }
+        glDeleteRenderbuffers(1, &context->color);
+        glDeleteRenderbuffers(1, &context->depth_stencil);
+
+        eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(context->display, context->context);
+    }
+    if (context->display)
+        eglTerminate(context->display);
+    *context = (sf_context){};
+}
+
+void sf_context_make_current(const sf_context *context) {
+    eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->context);
+}
+
+#else
+
+sf_result sf_context_new(sf_context *out, const sf_vec2 size) {
+    *out = (sf_context){ .size = size };
+    return sf_err(sf_lit("Headless contexts need sf-gfx to be built with SF_HEADLESS."));
+}
+
+void sf_context_delete(sf_context *context) {
+    *context = (sf_context){};
+}
+
+void sf_context_make_current([[maybe_unused]] const sf_context *context) {}
+
+#endif
+
+void sf_context_resize(sf_context *context, const sf_vec2 size) {
+    context->size = size;
+    glBindRenderbuffer(GL_RENDERBUFFER, context->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei)size.x, (GLsizei)size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, context->depth_stencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (GLsizei)size.x, (GLsizei)size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sf/fs.h>
+#include "sf/loader.h"
+#include "sf/state.h"
+#include "sf/stream.h"
+#include "stb/stb_image.h"
+
+/// Take jobs off the queue and decode them until the loader stops.
+static int sf_loader_work(void *arg) {
+    sf_loader *loader = arg;
+    stbi_set_flip_vertically_on_load_thread(1);
+
+    mtx_lock(&loader->lock);
+    while (true) {
+        while (!loader->stopping && loader->head == loader->queue.count)
+            cnd_wait(&loader->wake, &loader->lock);
+        if (loader->stopping)
+            break;
+        sf_texture_job *job = ((sf_texture_job **)loader->queue.data)[loader->head++];
+        if (loader->head == loader->queue.count)
+            loader->head = loader->queue.count = 0;
+
+        // Cancelled jobs still go back to the OpenGL thread, which is the only one that frees them.
+        if (!job->cancelled) {
+            mtx_unlock(&loader->lock);
+            sf_result result = sf_ok();
+            int width = 0, height = 0, channels;
+            uint8_t *pixels = nullptr;
+            if (!sf_file_exists(job->path))
+                result = sf_err(sf_str_fmt("File '%s' does not exist.", job->path.c_str));
+            else if (!(pixels = stbi_load(job->path.c_str, &width, &height, &channels, 4 /* RGBA */)))
+                result = sf_err(sf_str_fmt("File '%s' could not be loaded.", job->path.c_str));
+            mtx_lock(&loader->lock);
+
+            job->result = result;
+            job->pixels = pixels;
+            job->dimensions = (sf_vec2){(float)width, (float)height};
+        }
+        sf_vec_push(&loader->decoded, &job);
+    }
+    mtx_unlock(&loader->lock);
+    return 0;
+}
+
+sf_result sf_loader_new(sf_loader *out, const size_t workers, const size_t budget) {
+    *out = (sf_loader){
+        .worker_count = workers ? workers : SF_LOADER_WORKERS,
+        .queue = sf_vec_new(sf_texture_job *),
+        .decoded = sf_vec_new(sf_texture_job *),
+        .jobs = sf_vec_new(sf_texture_job *),
+        .uploads = sf_vec_new(sf_texture_job *),
+        .budget = budget ? budget : SF_LOADER_BUDGET,
+    };
+    if (mtx_init(&out->lock, mtx_plain) != thrd_success || cnd_init(&out->wake) != thrd_success)
+        return sf_err(sf_lit("Failed to create the texture loader's lock."));
+
+    out->workers = sf_malloc(out->worker_count * sizeof(thrd_t));
+    for (size_t i = 0; i < out->worker_count; ++i)
+        if (thrd_create(&out->workers[i], sf_loader_work, out) != thrd_success) {
+            out->worker_count = i;
+            sf_loader_delete(out);
+            return sf_err(sf_lit("Failed to start the texture loader's workers."));
+        }
+
+    const uint8_t white[4] = {255, 255, 255, 255};
+    out->placeholder = sf_texture_new(SF_TEXTURE_RGBA, (sf_vec2){1, 1}, SF_TEXTURE_SAMPLED);
+    sf_texture_write(&out->placeholder, white);
+    return sf_ok();
+}
+
+/// Free a job and everything it holds. Only called once no worker can still have it.
+static void sf_loader_free(sf_loader *loader, sf_texture_job *job) {
+    sf_texture_job **jobs = loader->jobs.data;
+    for (size_t i = 0; i < loader->jobs.count; ++i)
+        if (jobs[i] == job) {
+            jobs[i] = jobs[--loader->jobs.count];
+            break;
+        }
+
+    if (job->pixels)
+        stbi_image_free(job->pixels);
+    if (job->staging.handle)
+        sf_texture_delete(&job->staging);
+    if (job->texture.handle != loader->placeholder.handle)
+        sf_texture_delete(&job->texture);
+    if (!job->result.ok)
+        sf_str_free(job->result.err);
+    sf_str_free(job->path);
+    free(job);
+}
+
+void sf_loader_delete(sf_loader *loader) {
+    mtx_lock(&loader->lock);
+    loader->stopping = true;
+    cnd_broadcast(&loader->wake);
+    mtx_unlock(&loader->lock);
+    for (size_t i = 0; i < loader->worker_count; ++i)
+        thrd_join(loader->workers[i], nullptr);
+    free(loader->workers);
+
+    while (loader->jobs.count)
+        sf_loader_free(loader, ((sf_texture_job **)loader->jobs.data)[0]);
+    if (loader->placeholder.handle)
+        sf_texture_delete(&loader->placeholder);
+
+    mtx_destroy(&loader->lock);
+    cnd_destroy(&loader->wake);
+    sf_vec_delete(&loader->queue);
+    sf_vec_delete(&loader->decoded);
+    sf_vec_delete(&loader->jobs);
+    sf_vec_delete(&loader->uploads);
+    *loader = (sf_loader){};
+}
+
+sf_texture_job *sf_texture_load_async(sf_loader *loader, const sf_str path, const sf_texture_callback callback, void *user) {
+    sf_texture_job *job = sf_malloc(sizeof(sf_texture_job));
+    *job = (sf_texture_job){
+        .texture = loader->placeholder,
+        .state = SF_TEXTURE_JOB_QUEUED,
+        .result = sf_ok(),
+        .path = sf_str_dup(path),
+        .callback = callback,
+        .user = user,
+    };
+    sf_vec_push(&loader->jobs, &job);
+
+    mtx_lock(&loader->lock);
+    sf_vec_push(&loader->queue, &job);
+    cnd_signal(&loader->wake);
+    mtx_unlock(&loader->lock);
+    return job;
+}
+
+void sf_texture_job_delete(sf_loader *loader, sf_texture_job *job) {
+    if (sf_texture_job_done(job)) {
+        sf_loader_free(loader, job);
+        return;
+    }
+    // A worker or the upload queue still has it, sf_loader_update frees it when it comes back around.
+    mtx_lock(&loader->lock);
+    job->cancelled = true;
+    mtx_unlock(&loader->lock);
+}
+
+/// Upload up to rows more rows of a job's image, returning the bytes uploaded.
+/// Rows go through the current stream as a pixel unpack buffer when it has room, so the copy to vram is asynchronous.
+static size_t sf_loader_upload(sf_texture_job *job, size_t rows) {
+    const size_t row_size = (size_t)job->dimensions.x * 4;
+    const uint32_t height = (uint32_t)job->dimensions.y;
+    if (rows > height - job->rows)
+        rows = height - job->rows;
+    const uint8_t *src = job->pixels + job->rows * row_size;
+    const void *pixels = src;
+
+    sf_stream *stream = sf_stream_current();
+    sf_stream_range range;
+    if (stream) {
+        // Only take what the frame has room for, a miss would grow the stream to fit whole textures.
+        const size_t room = stream->frame_size > stream->head + 3 ? stream->frame_size - stream->head - 3 : 0;
+        if (room >= row_size) {
+            if (rows > room / row_size)
+                rows = room / row_size;
+            if (sf_stream_write(stream, src, rows * row_size, 4, &range)) {
+                sf_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, range.buffer);
+                pixels = (const void *)(uintptr_t)range.offset;
+            }
+        }
+    }
+
+    sf_gl_bind_texture(job->staging.handle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (GLint)job->rows, (GLsizei)job->dimensions.x, (GLsizei)rows,
+        GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    if (pixels != src)
+        sf_gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    job->rows += (uint32_t)rows;
+    return rows * row_size;
+}
+
+void sf_loader_update(sf_loader *loader) {
+    mtx_lock(&loader->lock);
+    sf_texture_job **decoded = loader->decoded.data;
+    for (size_t i = 0; i < loader->decoded.count; ++i)
+        sf_vec_push(&loader->uploads, &decoded[i]);
+    loader->decoded.count = 0;
+    mtx_unlock(&loader->lock);
+
+    size_t spent = 0;
+    size_t kept = 0;
+    sf_texture_job **uploads = loader->uploads.data;
+    const size_t count = loader->uploads.count;
+    for (size_t i = 0; i < count; ++i) {
+        sf_texture_job *job = uploads[i];
+        if (job->cancelled) {
+            sf_loader_free(loader, job);
+            continue;
+        }
+
+        if (job->state == SF_TEXTURE_JOB_QUEUED) {
+            if (!job->result.ok) {
+                job->state = SF_TEXTURE_JOB_FAILED;
+                if (job->callback)
+                    job->callback(job, job->user);
+                continue;
+            }
+            job->state = SF_TEXTURE_JOB_UPLOADING;
+            job->staging = sf_texture_new(SF_TEXTURE_RGBA, job->dimensions, SF_TEXTURE_SAMPLED | SF_TEXTURE_MIPMAPPED);
+        }
+
+        // Always make some progress, even when a single row is over the budget.
+        const size_t row_size = (size_t)job->dimensions.x * 4;
+        size_t rows = (loader->budget > spent ? loader->budget - spent : 0) / row_size;
+        if (rows == 0 && spent == 0)
+            rows = 1;
+        while (rows > 0 && job->rows < (uint32_t)job->dimensions.y) {
+            const size_t bytes = sf_loader_upload(job, rows);
+            spent += bytes;
+            rows -= bytes / row_size;
+        }
+
+        if (job->rows < (uint32_t)job->dimensions.y) {
+            uploads[kept++] = job;
+            continue;
+        }
+        sf_texture_update(&job->staging);
+        job->texture = job->staging;
+        job->staging = (sf_texture){};
+        stbi_image_free(job->pixels);
+        job->pixels = nullptr;
+        job->state = SF_TEXTURE_JOB_DONE;
+        if (job->callback)
+            job->callback(job, job->user);
+    }
+    loader->uploads.count = kept;
+}
@@ -0,0 +1,403 @@
+#include "sf/lod.h"
+
+#include <float.h>
+#include <math.h>
+
+/// How much more a plane along an open border weighs than the triangles around it, so outlines hold their shape.
+#define SF_SIMPLIFY_BORDER_WEIGHT 10.0f
+/// Smallest cosine between a triangle's normal before and after a collapse, anything less is a fold.
+#define SF_SIMPLIFY_FLIP 0.25f
+/// A level is only kept if it has at most this fraction of the triangles of the level before it.
+#define SF_MESH_LOD_MIN_REDUCTION 0.9f
+
+/// How a vertex may move during simplification.
+typedef enum : uint8_t {
+    SF_SIMPLIFY_MANIFOLD, /// Inside a surface, collapses onto any neighbour.
+    SF_SIMPLIFY_BORDER,   /// On an open edge, only collapses along it.
+    SF_SIMPLIFY_LOCKED,   /// Shares its position with other vertices (a seam), never moves.
+} sf_simplify_kind;
+
+/// Sum of squared distances to a set of planes, weighted by area.
+typedef struct {
+    float a2, b2, c2, d2, ab, ac, ad, bc, bd, cd;
+    float weight;
+} sf_quadric;
+
+/// A possible collapse of vertex from onto vertex to.
+typedef struct {
+    uint32_t from, to;
+    float error;
+} sf_collapse;
+
+static void sf_quadric_add_plane(sf_quadric *q, const vec3 n, const float d, const float weight) {
+    q->a2 += n[0] * n[0] * weight;
+    q->b2 += n[1] * n[1] * weight;
+    q->c2 += n[2] * n[2] * weight;
+    q->d2 += d * d * weight;
+    q->ab += n[0] * n[1] * weight;
+    q->ac += n[0] * n[2] * weight;
+    q->ad += n[0] * d * weight;
+    q->bc += n[1] * n[2] * weight;
+    q->bd += n[1] * d * weight;
+    q->cd += n[2] * d * weight;
+    q->weight += weight;
+}
+
+static void sf_quadric_add(sf_quadric *q, const sf_quadric *other) {
+    q->a2 += other->a2; q->b2 += other->b2; q->c2 += other->c2; q->d2 += other->d2;
+    q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->bc += other->bc; q->bd += other->bd; q->cd += other->cd;
+    q->weight += other->weight;
+}
+
+/// Mean squared distance from a point to the quadric's planes.
+static float sf_quadric_error(const sf_quadric *q, const vec3 p) {
+    const float x = p[0], y = p[1], z = p[2];
+    const float rx = q->a2 * x + q->ab * y + q->ac * z;
+    const float ry = q->ab * x + q->b2 * y + q->bc * z;
+    const float rz = q->ac * x + q->bc * y + q->c2 * z;
+    const float r = rx * x + ry * y + rz * z + 2.0f * (q->ad * x + q->bd * y + q->cd * z) + q->d2;
+    return fabsf(r) / (q->weight > 0.0f ? q->weight : 1.0f);
+}
+
+static uint32_t sf_simplify_hash(const vec3 p) {
+    uint32_t bits[3];
+    memcpy(bits, p, sizeof(bits));
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+}
+
+static uint64_t sf_edge_key(const uint32_t a, const uint32_t b) {
+    return (uint64_t)a << 32 | b;
+}
+
+/// Open addressing set of directed edges, keys are sf_edge_key and UINT64_MAX marks an empty slot.
+typedef struct {
+    uint64_t *keys;
+    size_t mask;
+} sf_edge_set;
+
+static size_t sf_edge_slot(const sf_edge_set *set, const uint64_t key) {
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & set->mask;
+    while (set->keys[slot] != UINT64_MAX && set->keys[slot] != key)
+        slot = (slot + 1) & set->mask;
+    return slot;
+}
+
+static int sf_collapse_compare(const void *a, const void *b) {
+    const float x = ((const sf_collapse *)a)->error, y = ((const sf_collapse *)b)->error;
+    return (x > y) - (x < y);
+}
+
+/// Whether moving a vertex's triangles from its position to target would fold any of them over.
+static bool sf_simplify_flips(const vec3 *positions, const int32_t *indices, const uint32_t *remap, const uint32_t *offsets, const uint32_t *adjacency, const uint32_t from, const uint32_t to) {
+    for (uint32_t i = offsets[from]; i < offsets[from + 1]; ++i) {
+        const uint32_t t = adjacency[i];
+        uint32_t v[3];
+        for (size_t k = 0; k < 3; ++k)
+            v[k] = remap[indices[t * 3 + k]];
+        // Triangles containing both ends of the edge disappear.
+        if (v[0] == to || v[1] == to || v[2] == to || v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+            continue;
+        vec3 before, after, ab, ac;
+        glm_vec3_sub((float *)positions[v[1]], (float *)positions[v[0]], ab);
+        glm_vec3_sub((float *)positions[v[2]], (float *)positions[v[0]], ac);
+        glm_vec3_cross(ab, ac, before);
+        for (size_t k = 0; k < 3; ++k)
+            if (v[k] == from)
+                v[k] = to;
+        glm_vec3_sub((float *)positions[v[1]], (float *)positions[v[0]], ab);
+        glm_vec3_sub((float *)positions[v[2]], (float *)positions[v[0]], ac);
+        glm_vec3_cross(ab, ac, after);
+        if (glm_vec3_dot(before, after) < SF_SIMPLIFY_FLIP * glm_vec3_norm(before) * glm_vec3_norm(after))
+            return true;
+    }
+    return false;
+}
+
+/// Simplify a mesh into out, returning the largest error of any collapse relative to the mesh's size.
+static float sf_simplify(const sf_mesh *src, const float target_ratio, const float max_error, sf_mesh *out) {
+    *out = sf_mesh_new();
+    sf_mesh_set_layout(out, src->layout);
+    const size_t vertex_count = src->vertices.count;
+    size_t triangles = src->indices.count / 3;
+    if (triangles == 0)
+        return 0.0f;
+    const sf_vertex *vertices = src->vertices.data;
+
+    // Work in a unit box, so errors are relative to the mesh's size.
+    vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t v = 0; v < vertex_count; ++v) {
+        const vec3 p = {vertices[v].position.x, vertices[v].position.y, vertices[v].position.z};
+        glm_vec3_minv(min, (float *)p, min);
+        glm_vec3_maxv(max, (float *)p, max);
+    }
+    const float extent = glm_max(glm_max(max[0] - min[0], max[1] - min[1]), max[2] - min[2]);
+    const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    vec3 *positions = sf_malloc(vertex_count * sizeof(vec3));
+    for (size_t v = 0; v < vertex_count; ++v) {
+        positions[v][0] = (vertices[v].position.x - min[0]) * scale;
+        positions[v][1] = (vertices[v].position.y - min[1]) * scale;
+        positions[v][2] = (vertices[v].position.z - min[2]) * scale;
+    }
+
+    int32_t *indices = sf_malloc(triangles * 3 * sizeof(int32_t));
+    memcpy(indices, src->indices.data, triangles * 3 * sizeof(int32_t));
+
+    // Weld vertices by position alone, topology is decided between positions rather than vertices.
+    uint32_t *weld = sf_malloc(vertex_count * sizeof(uint32_t));
+    uint32_t *shared = sf_calloc(vertex_count, sizeof(uint32_t));
+    size_t mask = 1;
+    while (mask + 1 < vertex_count * 2)
+        mask = mask * 2 + 1;
+    uint32_t *table = sf_malloc((mask + 1) * sizeof(uint32_t));
+    memset(table, 0xFF, (mask + 1) * sizeof(uint32_t));
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        size_t slot = sf_simplify_hash(positions[v]) & mask;
+        while (table[slot] != UINT32_MAX && memcmp(positions[table[slot]], positions[v], sizeof(vec3)) != 0)
+            slot = (slot + 1) & mask;
+        if (table[slot] == UINT32_MAX)
+            table[slot] = v;
+        weld[v] = table[slot];
+        shared[weld[v]]++;
+    }
+    free(table);
+
+    // An edge between two positions is on a border if no triangle runs along it the other way.
+    sf_edge_set edges = {};
+    edges.mask = 1;
+    while (edges.mask + 1 < triangles * 6)
+        edges.mask = edges.mask * 2 + 1;
+    edges.keys = sf_malloc((edges.mask + 1) * sizeof(uint64_t));
+    memset(edges.keys, 0xFF, (edges.mask + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < triangles * 3; ++i) {
+        const uint32_t a = weld[indices[i]], b = weld[indices[i - i % 3 + (i + 1) % 3]];
+        const uint64_t key = sf_edge_key(a, b);
+        edges.keys[sf_edge_slot(&edges, key)] = key;
+    }
+
+    sf_simplify_kind *kinds = sf_malloc(vertex_count * sizeof(sf_simplify_kind));
+    sf_quadric *quadrics = sf_calloc(vertex_count, sizeof(sf_quadric));
+    for (size_t v = 0; v < vertex_count; ++v)
+        kinds[v] = shared[weld[v]] > 1 ? SF_SIMPLIFY_LOCKED : SF_SIMPLIFY_MANIFOLD;
+    for (size_t t = 0; t < triangles; ++t) {
+        const int32_t *tri = indices + t * 3;
+        vec3 ab, ac, normal;
+        glm_vec3_sub(positions[tri[1]], positions[tri[0]], ab);
+        glm_vec3_sub(positions[tri[2]], positions[tri[0]], ac);
+        glm_vec3_cross(ab, ac, normal);
+        const float area = glm_vec3_norm(normal) * 0.5f;
+        if (area <= 0.0f)
+            continue;
+        glm_vec3_normalize(normal);
+        const float d = -glm_vec3_dot(normal, positions[tri[0]]);
+        for (size_t k = 0; k < 3; ++k)
+            sf_quadric_add_plane(&quadrics[tri[k]], normal, d, area);
+
+        for (size_t k = 0; k < 3; ++k) {
+            const int32_t a = tri[k], b = tri[(k + 1) % 3];
+            if (edges.keys[sf_edge_slot(&edges, sf_edge_key(weld[b], weld[a]))] != UINT64_MAX)
+                continue;
+            // Hold the border in place with a plane through it, perpendicular to the triangle.
+            vec3 edge, plane;
+            glm_vec3_sub(positions[b], positions[a], edge);
+            const float length = glm_vec3_norm(edge);
+            glm_vec3_cross(edge, normal, plane);
+            glm_vec3_normalize(plane);
+            const float pd = -glm_vec3_dot(plane, positions[a]);
+            sf_quadric_add_plane(&quadrics[a], plane, pd, length * length * SF_SIMPLIFY_BORDER_WEIGHT);
+            sf_quadric_add_plane(&quadrics[b], plane, pd, length * length * SF_SIMPLIFY_BORDER_WEIGHT);
+            if (kinds[a] == SF_SIMPLIFY_MANIFOLD)
+                kinds[a] = SF_SIMPLIFY_BORDER;
+            if (kinds[b] == SF_SIMPLIFY_MANIFOLD)
+                kinds[b] = SF_SIMPLIFY_BORDER;
+        }
+    }
+    free(shared);
+
+    // Collapse in passes: find every allowed collapse, then apply the cheapest ones that don't share a vertex.
+    const size_t target = (size_t)((float)triangles * glm_clamp(target_ratio, 0.0f, 1.0f));
+    const float limit = max_error * max_error;
+    uint32_t *offsets = sf_malloc((vertex_count + 1) * sizeof(uint32_t));
+    uint32_t *adjacency = sf_malloc(triangles * 3 * sizeof(uint32_t));
+    uint32_t *remap = sf_malloc(vertex_count * sizeof(uint32_t));
+    bool *touched = sf_malloc(vertex_count * sizeof(bool));
+    sf_collapse *collapses = sf_malloc(triangles * 3 * sizeof(sf_collapse));
+    float error = 0.0f;
+    while (triangles > target) {
+        memset(offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+        for (size_t i = 0; i < triangles * 3; ++i)
+            offsets[indices[i] + 1]++;
+        for (size_t v = 0; v < vertex_count; ++v)
+            offsets[v + 1] += offsets[v];
+        for (size_t t = 0; t < triangles; ++t)
+            for (size_t k = 0; k < 3; ++k)
+                adjacency[offsets[indices[t * 3 + k]]++] = (uint32_t)t;
+        for (size_t v = vertex_count; v > 0; --v)
+            offsets[v] = offsets[v - 1];
+        offsets[0] = 0;
+
+        size_t candidates = 0;
+        for (size_t i = 0; i < triangles * 3; ++i) {
+            const uint32_t a = (uint32_t)indices[i], b = (uint32_t)indices[i - i % 3 + (i + 1) % 3];
+            const bool border = edges.keys[sf_edge_slot(&edges, sf_edge_key(weld[b], weld[a]))] == UINT64_MAX;
+            sf_collapse best = { .error = FLT_MAX };
+            const uint32_t ends[2][2] = {{a, b}, {b, a}};
+            for (size_t e = 0; e < 2; ++e) {
+                const uint32_t from = ends[e][0], to = ends[e][1];
+                if (kinds[from] == SF_SIMPLIFY_LOCKED || (kinds[from] == SF_SIMPLIFY_BORDER && !border))
+                    continue;
+                const float cost = sf_quadric_error(&quadrics[from], positions[to]);
+                if (cost < best.error)
+                    best = (sf_collapse){ from, to, cost };
+            }
+            if (best.error <= limit)
+                collapses[candidates++] = best;
+        }
+        if (candidates == 0)
+            break;
+        qsort(collapses, candidates, sizeof(sf_collapse), sf_collapse_compare);
+
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            remap[v] = v;
+        memset(touched, 0, vertex_count * sizeof(bool));
+        size_t removed = 0, applied = 0;
+        for (size_t i = 0; i < candidates && triangles - removed > target; ++i) {
+            const sf_collapse c = collapses[i];
+            if (touched[c.from] || touched[c.to] || sf_simplify_flips(positions, indices, remap, offsets, adjacency, c.from, c.to))
+                continue;
+            remap[c.from] = c.to;
+            sf_quadric_add(&quadrics[c.to], &quadrics[c.from]);
+            touched[c.from] = touched[c.to] = true;
+            error = glm_max(error, c.error);
+            removed += kinds[c.from] == SF_SIMPLIFY_BORDER ? 1 : 2;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles; ++t) {
+            const int32_t a = (int32_t)remap[indices[t * 3]], b = (int32_t)remap[indices[t * 3 + 1]], c = (int32_t)remap[indices[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            indices[kept * 3] = a;
+            indices[kept * 3 + 1] = b;
+            indices[kept * 3 + 2] = c;
+            kept++;
+        }
+        triangles = kept;
+    }
+
+    for (size_t t = 0; t < triangles; ++t) {
+        const sf_vertex triangle[3] = {vertices[indices[t * 3]], vertices[indices[t * 3 + 1]], vertices[indices[t * 3 + 2]]};
+        sf_mesh_add_vertices(out, triangle, 3);
+    }
+
+    free(positions);
+    free(indices);
+    free(weld);
+    free(edges.keys);
+    free(kinds);
+    free(quadrics);
+    free(offsets);
+    free(adjacency);
+    free(remap);
+    free(touched);
+    free(collapses);
+    return sqrtf(error);
+}
+
+sf_mesh sf_mesh_simplify(const sf_mesh *src, const float target_ratio, const float max_error) {
+    sf_mesh out;
+    sf_simplify(src, target_ratio, max_error, &out);
+    return out;
+}
+
+sf_mesh_lod sf_mesh_lod_new(sf_mesh *mesh, const size_t count, const float max_error) {
+    sf_mesh_lod lod = {
+        .base = mesh,
+        .count = 1,
+        .threshold = SF_MESH_LOD_THRESHOLD,
+    };
+
+    const sf_vertex *vertices = mesh->vertices.data;
+    vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t v = 0; v < mesh->vertices.count; ++v) {
+        const vec3 p = {vertices[v].position.x, vertices[v].position.y, vertices[v].position.z};
+        glm_vec3_minv(min, (float *)p, min);
+        glm_vec3_maxv(max, (float *)p, max);
+    }
+    if (mesh->vertices.count == 0)
+        return lod;
+    lod.center = (sf_vec3){(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f};
+    const float extent = glm_max(glm_max(max[0] - min[0], max[1] - min[1]), max[2] - min[2]);
+    for (size_t v = 0; v < mesh->vertices.count; ++v) {
+        vec3 offset = {vertices[v].position.x - lod.center.x, vertices[v].position.y - lod.center.y, vertices[v].position.z - lod.center.z};
+        lod.radius = glm_max(lod.radius, glm_vec3_norm(offset));
+    }
+
+    // Each level is simplified from the last, so errors add up along the chain.
+    const size_t levels = count < SF_MESH_LOD_MAX ? count : SF_MESH_LOD_MAX;
+    const sf_mesh *previous = mesh;
+    while (lod.count < levels) {
+        sf_mesh *level = &lod.levels[lod.count - 1];
+        const float error = sf_simplify(previous, 0.5f, max_error, level) * extent;
+        if ((float)level->indices.count > (float)previous->indices.count * SF_MESH_LOD_MIN_REDUCTION || level->indices.count == 0) {
+            sf_mesh_delete(level);
+            break;
+        }
+        lod.errors[lod.count] = lod.errors[lod.count - 1] + error;
+        previous = level;
+        lod.count++;
+    }
+    return lod;
+}
+
+void sf_mesh_lod_delete(sf_mesh_lod *lod) {
+    for (size_t i = 1; i < lod->count; ++i)
+        sf_mesh_delete(&lod->levels[i - 1]);
+    lod->count = 0;
+    lod->base = nullptr;
+}
+
+size_t sf_mesh_lod_select(const sf_mesh_lod *lod, sf_camera *camera, const mat4 model) {
+    sf_camera_refresh(camera);
+    const float height = camera->size.y;
+    if (lod->count < 2 || camera->type == SF_CAMERA_RENDER_DEFAULT || height <= 0.0f)
+        return 0;
+
+    // Errors scale with the largest axis of the model matrix, and are measured at the nearest point of the bounds.
+    const float scale = sqrtf(glm_max(glm_max(
+        glm_vec3_norm2((float *)model[0]), glm_vec3_norm2((float *)model[1])), glm_vec3_norm2((float *)model[2])));
+    vec4 center = {lod->center.x, lod->center.y, lod->center.z, 1.0f}, world, view;
+    glm_mat4_mulv((vec4 *)model, center, world);
+    glm_mat4_mulv((vec4 *)camera->block.campos, world, view);
+    const mat4 *projection = &camera->block.projection;
+    // Clip space w, the distance along the view for a perspective projection and 1 for an orthographic one.
+    float w = (*projection)[0][3] * view[0] + (*projection)[1][3] * view[1] + (*projection)[2][3] * view[2] + (*projection)[3][3];
+    if ((*projection)[2][3] != 0.0f)
+        w -= lod->radius * scale;
+    if (w <= 0.0f)
+        return 0;
+
+    // A model space error covers this many pixels at distance w.
+    const float pixels = scale * (*projection)[1][1] * 0.5f * height / w;
+    size_t level = 0;
+    while (level + 1 < lod->count && lod->errors[level + 1] * pixels <= lod->threshold)
+        level++;
+    return level;
+}
+
+static sf_mesh *sf_mesh_lod_level(sf_mesh_lod *lod, const size_t level) {
+    return level == 0 ? lod->base : &lod->levels[level - 1];
+}
+
+sf_result sf_mesh_lod_draw(sf_mesh_lod *lod, sf_shader *shader, sf_camera *camera, const sf_transform transform, const sf_texture *texture) {
+    mat4 model;
+    sf_transform_model(model, transform);
+    return sf_mesh_lod_draw_matrix(lod, shader, camera, model, texture);
+}
+
+sf_result sf_mesh_lod_draw_matrix(sf_mesh_lod *lod, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture) {
+    return sf_mesh_draw_matrix(sf_mesh_lod_level(lod, sf_mesh_lod_select(lod, camera, model)), shader, camera, model, texture);
+}
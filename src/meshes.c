@@ -1,42 +1,54 @@
 #include "sf/meshes.h"
 
 #include "sf/camera.h"
+#include "sf/state.h"
+#include "sf/stream.h"
 
-#define CLEAN_BIND true
-const sf_camera *SF_RENDER_DEFAULT = &(sf_camera){
-    .type = SF_CAMERA_RENDER_DEFAULT,
-    .transform = SF_TRANSFORM_IDENTITY,
-    .framebuffer = 0,
-};
+void sf_instance_source(const GLuint buffer, const GLintptr offset) {
+    sf_gl_bind_buffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint i = 0; i < 4; ++i) {
+        glEnableVertexAttribArray(SF_INSTANCE_ATTRIBUTE + i);
+        glVertexAttribPointer(SF_INSTANCE_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(offset + (GLintptr)(i * sizeof(vec4))));
+    }
+}
+
+void sf_instance_identity() {
+    // Disabled arrays read the context's current attribute values, which no buffer write can invalidate.
+    for (GLuint i = 0; i < 4; ++i) {
+        glDisableVertexAttribArray(SF_INSTANCE_ATTRIBUTE + i);
+        glVertexAttrib4f(SF_INSTANCE_ATTRIBUTE + i, i == 0, i == 1, i == 2, i == 3);
+    }
+}
+
+void sf_instance_attributes(const GLuint ibo) {
+    // Instance Model Matrix
+    sf_gl_bind_buffer(GL_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4), nullptr, GL_STREAM_DRAW);
+    for (GLuint i = 0; i < 4; ++i)
+        glVertexAttribDivisor(SF_INSTANCE_ATTRIBUTE + i, 1);
+    sf_instance_source(ibo, 0);
+}
 
 sf_mesh sf_mesh_new() {
     sf_mesh mesh = {
         .vertices = sf_vec_new(sf_vertex),
         .indices = sf_vec_new(int32_t),
-        .cache = sf_map_new(),
+        .layout = SF_VERTEX_LAYOUT_DEFAULT,
+        .index_type = GL_UNSIGNED_SHORT,
         .flags = SF_MESH_ACTIVE | SF_MESH_VISIBLE,
     };
 
     glGenVertexArrays(1, &mesh.vao);
     glGenBuffers(1, &mesh.vbo);
     glGenBuffers(1, &mesh.ebo);
+    glGenBuffers(1, &mesh.ibo);
 
-    glBindVertexArray(mesh.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    // Vertex Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), nullptr);
-    // UV Coords
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
-    // Vertex Color
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(5 * sizeof(float)));
-
-    if (CLEAN_BIND) {
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-    }
+    sf_gl_bind_vertex_array(mesh.vao);
+    // The vertex array keeps its element buffer bound, so draws only need to bind the vertex array.
+    sf_gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    sf_vertex_attributes(&mesh.layout, mesh.vbo);
+    sf_instance_attributes(mesh.ibo);
+    mesh.ibo_capacity = 1;
 
     sf_opengl_log();
 
@@ -46,95 +58,347 @@ sf_mesh sf_mesh_new() {
 void sf_mesh_delete(sf_mesh *mesh) {
     sf_vec_delete(&mesh->vertices);
     sf_vec_delete(&mesh->indices);
-    sf_map_delete(&mesh->cache);
+    free(mesh->cache.slots);
+    mesh->cache = (sf_vertex_table){};
 
+    sf_gl_forget_vertex_array(mesh->vao);
+    sf_gl_forget_buffer(mesh->vbo);
+    sf_gl_forget_buffer(mesh->ebo);
+    sf_gl_forget_buffer(mesh->ibo);
     glDeleteVertexArrays(1, &mesh->vao);
     glDeleteBuffers(1, &mesh->vbo);
     glDeleteBuffers(1, &mesh->ebo);
+    glDeleteBuffers(1, &mesh->ibo);
 
     mesh->flags &= ~SF_MESH_ACTIVE;
     mesh->flags &= ~SF_MESH_VISIBLE;
 }
 
-void sf_mesh_update(const sf_mesh *mesh) {
-    glBindVertexArray(mesh->vao);
+void sf_mesh_set_layout(sf_mesh *mesh, const sf_vertex_layout layout) {
+    mesh->layout = layout;
+    sf_gl_bind_vertex_array(mesh->vao);
+    sf_vertex_attributes(&mesh->layout, mesh->vbo);
+    // The stride changed, so the buffer is reallocated at the new size.
+    mesh->vbo_capacity = 0;
+    mesh->dirty_vertices = (sf_mesh_range){0, mesh->vertices.count};
+}
+
+static void sf_mesh_range_add(sf_mesh_range *range, const size_t begin, const size_t end) {
+    if (range->begin >= range->end) {
+        *range = (sf_mesh_range){begin, end};
+        return;
+    }
+    if (begin < range->begin) range->begin = begin;
+    if (end > range->end) range->end = end;
+}
+
+/// Writes count of a mesh's elements starting at first to the buffer bound to target, in their vram format.
+typedef void (*sf_mesh_writer)(const sf_mesh *mesh, GLenum target, size_t first, size_t count);
+
+static void sf_mesh_write_vertices(const sf_mesh *mesh, const GLenum target, const size_t first, const size_t count) {
+    sf_vertex_upload(&mesh->layout, target, (GLintptr)(first * mesh->layout.stride), (const sf_vertex *)mesh->vertices.data + first, count);
+}
+
+static void sf_mesh_write_indices(const sf_mesh *mesh, const GLenum target, const size_t first, const size_t count) {
+    const int32_t *indices = (const int32_t *)mesh->indices.data + first;
+    sf_stream *stream = sf_stream_current();
+    if (mesh->index_type == GL_UNSIGNED_INT) {
+        // Copying from the stream on the gpu doesn't wait for draws still reading the buffer.
+        const GLintptr offset = (GLintptr)(first * sizeof(int32_t));
+        if (!stream || !sf_stream_copy(stream, target, offset, indices, count * sizeof(int32_t)))
+            glBufferSubData(target, offset, (GLsizeiptr)(count * sizeof(int32_t)), indices);
+        return;
+    }
+
+    const GLintptr offset = (GLintptr)(first * sizeof(uint16_t));
+    sf_stream_range range;
+    uint16_t *narrow = stream ? sf_stream_map(stream, count * sizeof(uint16_t), 4, &range) : nullptr;
+    const bool streamed = narrow != nullptr;
+    if (!streamed)
+        narrow = sf_malloc(count * sizeof(uint16_t));
+    for (size_t i = 0; i < count; ++i)
+        narrow[i] = (uint16_t)indices[i];
+
+    if (streamed) {
+        sf_stream_unmap(stream);
+        sf_gl_bind_buffer(GL_COPY_READ_BUFFER, range.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, range.offset, offset, range.size);
+    } else {
+        glBufferSubData(target, offset, (GLsizeiptr)(count * sizeof(uint16_t)), narrow);
+        free(narrow);
+    }
+}
+
+/// Copy the dirty range of a mesh's elements into a buffer, growing the buffer geometrically if it's too small.
+static void sf_mesh_upload(const sf_mesh *mesh, const GLenum target, const GLuint buffer, const GLenum usage, const size_t count, const size_t element_size, size_t *capacity, sf_mesh_range *dirty, const sf_mesh_writer write) {
+    if (dirty->begin >= dirty->end)
+        return;
+
+    sf_gl_bind_buffer(target, buffer);
+    if (count > *capacity) {
+        size_t cap = *capacity ? *capacity : SF_MESH_MIN_CAPACITY;
+        while (cap < count)
+            cap *= 2;
+        glBufferData(target, (GLsizeiptr)(cap * element_size), nullptr, usage);
+        *capacity = cap;
+        // The old contents are gone along with the old storage.
+        *dirty = (sf_mesh_range){0, count};
+    }
+
+    const size_t end = dirty->end < count ? dirty->end : count;
+    if (dirty->begin < end)
+        write(mesh, target, dirty->begin, end - dirty->begin);
+    *dirty = (sf_mesh_range){0, 0};
+}
+
+void sf_mesh_update(sf_mesh *mesh) {
+    // 16-bit indices can only address the first 65536 vertices, past that every index is uploaded again as 32-bit.
+    if (mesh->index_type == GL_UNSIGNED_SHORT && mesh->vertices.count > SF_MESH_SHORT_INDICES) {
+        mesh->index_type = GL_UNSIGNED_INT;
+        mesh->ebo_capacity = 0;
+        mesh->dirty_indices = (sf_mesh_range){0, mesh->indices.count};
+    }
+    if (mesh->dirty_vertices.begin >= mesh->dirty_vertices.end && mesh->dirty_indices.begin >= mesh->dirty_indices.end)
+        return;
+    if (mesh->dirty_vertices.begin < mesh->dirty_vertices.end)
+        mesh->bounds = sf_bounds_compute(mesh->vertices.data, mesh->vertices.count);
+
+    sf_gl_bind_vertex_array(mesh->vao);
+    sf_mesh_upload(mesh, GL_ARRAY_BUFFER, mesh->vbo, GL_DYNAMIC_DRAW, mesh->vertices.count, mesh->layout.stride,
+        &mesh->vbo_capacity, &mesh->dirty_vertices, sf_mesh_write_vertices);
+    sf_mesh_upload(mesh, GL_ELEMENT_ARRAY_BUFFER, mesh->ebo, GL_STATIC_DRAW, mesh->indices.count,
+        mesh->index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(int32_t),
+        &mesh->ebo_capacity, &mesh->dirty_indices, sf_mesh_write_indices);
+}
+
+void sf_mesh_touch(sf_mesh *mesh, const size_t first, const size_t count) {
+    sf_mesh_range_add(&mesh->dirty_vertices, first, first + count);
+    // Slots hash the old contents. Rebuilding is deferred, meshes that are rewritten every frame rarely add vertices.
+    if (count)
+        mesh->cache.stale = true;
+}
+
+static inline uint32_t sf_rotl32(const uint32_t x, const int r) { return (x << r) | (x >> (32 - r)); }
+
+/// Hash the packed bytes of a vertex.
+/// The four accumulators are independent so the rounds vectorize, similar to xxHash32.
+static inline uint32_t sf_vertex_hash(const sf_vertex *vertex) {
+    static_assert(sizeof(sf_vertex) == 9 * sizeof(uint32_t), "sf_vertex is expected to be 9 packed words.");
+    static const uint32_t p1 = 0x9E3779B1u, p2 = 0x85EBCA77u, p3 = 0xC2B2AE3Du, p4 = 0x27D4EB2Fu;
+
+    uint32_t w[9];
+    memcpy(w, vertex, sizeof(w));
+
+    uint32_t acc[4] = {p1 + p2, p2, 0, -p1};
+    for (int r = 0; r < 2; ++r)
+        for (int l = 0; l < 4; ++l)
+            acc[l] = sf_rotl32(acc[l] + w[r * 4 + l] * p2, 13) * p1;
+
+    uint32_t h = sf_rotl32(acc[0], 1) + sf_rotl32(acc[1], 7) + sf_rotl32(acc[2], 12) + sf_rotl32(acc[3], 18);
+    h = sf_rotl32(h + w[8] * p3, 17) * p4;
+    h ^= h >> 15;
+    h *= p2;
+    h ^= h >> 13;
+    h *= p3;
+    h ^= h >> 16;
+    return h;
+}
+
+/// Make sure a table can hold count entries while staying under a 3/4 load factor.
+static void sf_vertex_table_reserve(sf_vertex_table *table, const size_t count) {
+    if (count * 4 <= table->capacity * 3)
+        return;
+
+    size_t cap = table->capacity ? table->capacity : SF_MESH_MIN_CAPACITY;
+    while (count * 4 > cap * 3)
+        cap *= 2;
+
+    sf_vertex_slot *slots = sf_malloc(cap * sizeof(sf_vertex_slot));
+    for (size_t i = 0; i < cap; ++i)
+        slots[i].index = -1;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-    glBufferData(GL_ARRAY_BUFFER, (int64_t)(mesh->vertices.count * mesh->vertices.element_size), mesh->vertices.data, GL_DYNAMIC_DRAW);
+    // Hashes are stored, so rehashing never touches vertex data.
+    const size_t mask = cap - 1;
+    for (size_t i = 0; i < table->capacity; ++i) {
+        const sf_vertex_slot slot = table->slots[i];
+        if (slot.index < 0)
+            continue;
+        size_t s = slot.hash & mask;
+        while (slots[s].index >= 0)
+            s = (s + 1) & mask;
+        slots[s] = slot;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = cap;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (int64_t)(mesh->indices.count * mesh->indices.element_size), mesh->indices.data, GL_STATIC_DRAW);
+/// Find a vertex in the table, or insert it with the provided index.
+/// Returns the existing index, or -1 if the vertex was inserted.
+static int32_t sf_vertex_table_insert(sf_vertex_table *table, const sf_vertex *vertices, const sf_vertex *vertex, const uint32_t hash, const int32_t index) {
+    sf_vertex_table_reserve(table, table->count + 1);
 
-    if (CLEAN_BIND) {
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    const size_t mask = table->capacity - 1;
+    for (size_t s = hash & mask;; s = (s + 1) & mask) {
+        sf_vertex_slot *slot = &table->slots[s];
+        if (slot->index < 0) {
+            *slot = (sf_vertex_slot){hash, index};
+            table->count++;
+            return -1;
+        }
+        if (slot->hash == hash && memcmp(&vertices[slot->index], vertex, sizeof(sf_vertex)) == 0)
+            return slot->index;
     }
 }
 
-void _sf_mesh_add_vertex(sf_mesh *mesh, const sf_vertex vertex) {
-    const sf_map_key key = (sf_map_key){(uint8_t *)&vertex,sizeof(sf_vertex)};
-    if (sf_map_exists(&mesh->cache, key)) {
-        sf_vec_push(&mesh->indices, sf_map_get(&mesh->cache, key));
+/// Rehash every vertex of a mesh whose contents changed under its weld table.
+static void sf_vertex_table_rebuild(sf_mesh *mesh) {
+    sf_vertex_table *table = &mesh->cache;
+    for (size_t i = 0; i < table->capacity; ++i)
+        table->slots[i].index = -1;
+    table->count = 0;
+    table->stale = false;
+
+    // Vertices that became equal stay separate, only the first one is welded onto from now on.
+    const sf_vertex *vertices = mesh->vertices.data;
+    sf_vertex_table_reserve(table, mesh->vertices.count);
+    for (size_t i = 0; i < mesh->vertices.count; ++i)
+        sf_vertex_table_insert(table, vertices, &vertices[i], sf_vertex_hash(&vertices[i]), (int32_t)i);
+}
+
+void _sf_mesh_add_vertex(sf_mesh *mesh, const sf_vertex *vertex, const uint32_t hash) {
+    if (mesh->cache.stale)
+        sf_vertex_table_rebuild(mesh);
+    const int32_t index = (int32_t)mesh->vertices.count;
+    const int32_t found = sf_vertex_table_insert(&mesh->cache, mesh->vertices.data, vertex, hash, index);
+    if (found >= 0) {
+        sf_vec_push(&mesh->indices, &found);
+        sf_mesh_range_add(&mesh->dirty_indices, mesh->indices.count - 1, mesh->indices.count);
         return;
     }
 
-    sf_vec_push(&mesh->vertices, &vertex);
-    sf_vec_push(&mesh->indices, &(int32_t){(int32_t)mesh->vertices.count - 1});
-    sf_map_insert(&mesh->cache, key, &(int32_t){(int32_t)mesh->vertices.count - 1}, sizeof(int32_t));
+    sf_vec_push(&mesh->vertices, vertex);
+    sf_vec_push(&mesh->indices, &index);
+    sf_mesh_range_add(&mesh->dirty_vertices, mesh->vertices.count - 1, mesh->vertices.count);
+    sf_mesh_range_add(&mesh->dirty_indices, mesh->indices.count - 1, mesh->indices.count);
 }
 
 void sf_mesh_add_vertex(sf_mesh *mesh, const sf_vertex vertex) {
-    _sf_mesh_add_vertex(mesh, vertex);
-    sf_mesh_update(mesh);
+    _sf_mesh_add_vertex(mesh, &vertex, sf_vertex_hash(&vertex));
 }
 
+#define SF_MESH_BATCH 256
 void sf_mesh_add_vertices(sf_mesh *mesh, const sf_vertex *vertices, const size_t count) {
-    for (size_t i = 0; i < count; ++i)
-        _sf_mesh_add_vertex(mesh, vertices[i]);
-    sf_mesh_update(mesh);
+    if (mesh->cache.stale)
+        sf_vertex_table_rebuild(mesh);
+    // Grow the table once up front instead of rehashing during the batch.
+    sf_vertex_table_reserve(&mesh->cache, mesh->cache.count + count);
+
+    uint32_t hashes[SF_MESH_BATCH];
+    for (size_t base = 0; base < count; base += SF_MESH_BATCH) {
+        const size_t n = count - base < SF_MESH_BATCH ? count - base : SF_MESH_BATCH;
+        for (size_t i = 0; i < n; ++i)
+            hashes[i] = sf_vertex_hash(&vertices[base + i]);
+        for (size_t i = 0; i < n; ++i)
+            _sf_mesh_add_vertex(mesh, &vertices[base + i], hashes[i]);
+    }
+}
+
+sf_result sf_mesh_draw(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const sf_transform transform, const sf_texture *texture) {
+    mat4 model;
+    sf_transform_model(model, transform);
+    return sf_mesh_draw_matrix(mesh, shader, camera, model, texture);
 }
 
-sf_result sf_mesh_draw(const sf_mesh *mesh, sf_shader *shader, const sf_camera *camera, const sf_transform transform, const sf_texture *texture) {
+sf_result sf_mesh_draw_matrix(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture) {
+    sf_mesh_update(mesh);
+    sf_camera_update(camera);
+    if (!sf_frustum_test_sphere(&camera->frustum, sf_sphere_transform(mesh->bounds.sphere, model)))
+        return sf_ok();
     sf_shader_bind(shader);
 
-    sf_result res;
-    if (camera->type == SF_CAMERA_RENDER_DEFAULT) {
-        mat4 identity;
-        glm_mat4_identity(identity);
-        res = sf_shader_uniform_mat4(shader, sf_lit("m_projection"), identity);
-    } else
-        res = sf_shader_uniform_mat4(shader, sf_lit("m_projection"), camera->projection);
+    if (shader->builtin.model == SF_UNIFORM_NONE)
+        return sf_err(sf_lit("Uniform 'm_model' not found."));
+    const sf_result res = sf_camera_bind(camera);
     if (!res.ok)
         return res;
 
-    mat4 campos;
-    sf_transform cp = camera->transform;
-    cp.position = (sf_vec3){-cp.position.x, -cp.position.y, -cp.position.z};
-    sf_transform_model(campos, cp);
-    res = sf_shader_uniform_mat4(shader, sf_lit("m_campos"), campos);
-    if (!res.ok)
-        return res;
+    sf_shader_set_mat4(shader, shader->builtin.model, model);
 
-    mat4 model;
-    sf_transform_model(model, transform);
-    res = sf_shader_uniform_mat4(shader, sf_lit("m_model"), model);
-    if (!res.ok)
-        return res;
+    sf_gl_bind_framebuffer(camera->framebuffer);
+    sf_gl_active_texture(0);
+    sf_gl_bind_texture(texture->handle);
+    sf_gl_bind_vertex_array(mesh->vao);
+    sf_instance_identity();
+    glDrawElements(GL_TRIANGLES, (int32_t)mesh->indices.count, mesh->index_type, nullptr);
+
+    return sf_ok();
+}
+
+#define SF_MESH_CULL_BATCH 64
+/// Write the model matrices of the instances inside the camera's view, returning how many there were.
+/// Transforms are converted a batch at a time, so culled instances never reach vram.
+static size_t sf_mesh_write_instances(const sf_mesh *mesh, const sf_camera *camera, mat4 *models, const sf_transform *transforms, const size_t count) {
+    mat4 batch[SF_MESH_CULL_BATCH];
+    sf_sphere spheres[SF_MESH_CULL_BATCH];
+    uint32_t visible[SF_MESH_CULL_BATCH];
+    size_t written = 0;
+    for (size_t base = 0; base < count; base += SF_MESH_CULL_BATCH) {
+        const size_t n = count - base < SF_MESH_CULL_BATCH ? count - base : SF_MESH_CULL_BATCH;
+        sf_transform_models(batch, transforms + base, n);
+        for (size_t i = 0; i < n; ++i)
+            spheres[i] = sf_sphere_transform(mesh->bounds.sphere, batch[i]);
+        const size_t inside = sf_frustum_cull(&camera->frustum, spheres, n, visible);
+        for (size_t i = 0; i < inside; ++i)
+            memcpy(models[written++], batch[visible[i]], sizeof(mat4));
+    }
+    return written;
+}
 
-    res = sf_shader_uniform_int(shader, sf_lit("t_sampler"), 0);
+sf_result sf_mesh_draw_instanced(sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const sf_transform *transforms, const size_t count, const sf_texture *texture) {
+    if (count == 0)
+        return sf_ok();
+
+    sf_mesh_update(mesh);
+    sf_camera_update(camera);
+    sf_shader_bind(shader);
+
+    const sf_result res = sf_camera_bind(camera);
     if (!res.ok)
         return res;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, camera->framebuffer);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture->handle);
-    glBindVertexArray(mesh->vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-    glDrawElements(GL_TRIANGLES, (int32_t)mesh->indices.count, GL_UNSIGNED_INT, nullptr);
+    sf_gl_bind_vertex_array(mesh->vao);
+    const size_t size = count * sizeof(mat4);
+    sf_stream *stream = sf_stream_current();
+    sf_stream_range range;
+    mat4 *models = stream ? sf_stream_map(stream, size, sizeof(vec4), &range) : nullptr;
+    size_t drawn;
+    if (models) {
+        drawn = sf_mesh_write_instances(mesh, camera, models, transforms, count);
+        sf_stream_unmap(stream);
+        sf_instance_source(range.buffer, range.offset);
+    } else {
+        // Orphan the instance buffer every frame so the driver doesn't wait on last frame's draw.
+        sf_gl_bind_buffer(GL_ARRAY_BUFFER, mesh->ibo);
+        while (mesh->ibo_capacity < count)
+            mesh->ibo_capacity *= 2;
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(mesh->ibo_capacity * sizeof(mat4)), nullptr, GL_STREAM_DRAW);
+        models = glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!models)
+            return sf_err(sf_lit("Failed to map a mesh's instance buffer."));
+        drawn = sf_mesh_write_instances(mesh, camera, models, transforms, count);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        sf_instance_source(mesh->ibo, 0);
+    }
+    if (drawn == 0)
+        return sf_ok();
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    sf_gl_bind_framebuffer(camera->framebuffer);
+    sf_gl_active_texture(0);
+    sf_gl_bind_texture(texture->handle);
+    sf_gl_bind_vertex_array(mesh->vao);
+    glDrawElementsInstanced(GL_TRIANGLES, (int32_t)mesh->indices.count, mesh->index_type, nullptr, (GLsizei)drawn);
 
     return sf_ok();
 }
@@ -0,0 +1,371 @@
+#include "sf/occlusion.h"
+
+#include <float.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// How far past the edges of the screen, in multiples of its half size, occluders are clipped.
+/// Keeps edge functions small enough for floats to resolve single pixels.
+#define SF_OCCLUSION_GUARD 4.0f
+
+/// An occluder triangle in pixels, wound counter-clockwise, with the depth of each corner.
+typedef struct {
+    float x[3], y[3], z[3];
+} sf_occlusion_triangle;
+
+sf_occlusion sf_occlusion_new(const sf_vec2 size) {
+    const uint32_t tile = SF_OCCLUSION_TILE;
+    sf_occlusion occlusion = {
+        .width = ((uint32_t)fmaxf(size.x, 1.0f) + tile - 1) / tile * tile,
+        .height = ((uint32_t)fmaxf(size.y, 1.0f) + tile - 1) / tile * tile,
+        .triangles = sf_vec_new(sf_occlusion_triangle),
+    };
+
+    // Halve the buffer until it's a single texel, every level is stored after the one before it.
+    size_t total = 0;
+    uint32_t w = occlusion.width, h = occlusion.height;
+    for (;;) {
+        occlusion.offsets[occlusion.levels] = total;
+        occlusion.widths[occlusion.levels] = w;
+        occlusion.heights[occlusion.levels] = h;
+        occlusion.levels++;
+        total += (size_t)w * h;
+        if ((w == 1 && h == 1) || occlusion.levels == SF_OCCLUSION_LEVELS)
+            break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    occlusion.depth = sf_malloc(total * sizeof(float));
+    for (size_t i = 0; i < total; ++i)
+        occlusion.depth[i] = 1.0f;
+
+    const size_t tiles = (size_t)(occlusion.width / tile) * (occlusion.height / tile);
+    occlusion.bin_offsets = sf_malloc((tiles + 1) * sizeof(uint32_t));
+    return occlusion;
+}
+
+void sf_occlusion_delete(sf_occlusion *occlusion) {
+    sf_vec_delete(&occlusion->triangles);
+    free(occlusion->depth);
+    free(occlusion->bins);
+    free(occlusion->bin_offsets);
+    *occlusion = (sf_occlusion){};
+}
+
+void sf_occlusion_begin(sf_occlusion *occlusion, sf_camera *camera) {
+    occlusion->camera = camera;
+    sf_camera_refresh(camera);
+    glm_mat4_mul((vec4 *)camera->block.projection, (vec4 *)camera->block.campos, occlusion->clip);
+    occlusion->triangles.count = 0;
+    occlusion->stats = (sf_occlusion_stats){};
+    const size_t pixels = (size_t)occlusion->width * occlusion->height;
+    for (size_t i = 0; i < pixels; ++i)
+        occlusion->depth[i] = 1.0f;
+}
+
+/// Project a clipped triangle to pixels, and queue it for rasterization unless it has no area.
+static void sf_occlusion_emit(sf_occlusion *occlusion, const vec4 a, const vec4 b, const vec4 c) {
+    const float *corners[3] = {a, b, c};
+    sf_occlusion_triangle triangle;
+    for (int k = 0; k < 3; ++k) {
+        const float *v = corners[k];
+        const float w = 1.0f / v[3];
+        triangle.x[k] = (v[0] * w * 0.5f + 0.5f) * (float)occlusion->width;
+        triangle.y[k] = (v[1] * w * 0.5f + 0.5f) * (float)occlusion->height;
+        triangle.z[k] = v[2] * w * 0.5f + 0.5f;
+    }
+    const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+        - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+    if (!(fabsf(area) > 0.0f))
+        return;
+    // Both sides are drawn, flip clockwise triangles so every edge function is positive inside.
+    if (area < 0.0f) {
+        float t = triangle.x[1]; triangle.x[1] = triangle.x[2]; triangle.x[2] = t;
+        t = triangle.y[1]; triangle.y[1] = triangle.y[2]; triangle.y[2] = t;
+        t = triangle.z[1]; triangle.z[1] = triangle.z[2]; triangle.z[2] = t;
+    }
+    sf_vec_push(&occlusion->triangles, &triangle);
+    occlusion->stats.occluder_triangles++;
+}
+
+void sf_occlusion_add_triangles(sf_occlusion *occlusion, const sf_vertex *vertices, const int32_t *indices, const size_t index_count, const mat4 model) {
+    // Clip against the near plane, and a guard band around the screen: dot(plane, v) >= 0 is kept.
+    static const vec4 planes[5] = {
+        {0.0f, 0.0f, 1.0f, 1.0f},
+        {1.0f, 0.0f, 0.0f, SF_OCCLUSION_GUARD}, {-1.0f, 0.0f, 0.0f, SF_OCCLUSION_GUARD},
+        {0.0f, 1.0f, 0.0f, SF_OCCLUSION_GUARD}, {0.0f, -1.0f, 0.0f, SF_OCCLUSION_GUARD},
+    };
+    mat4 clip;
+    glm_mat4_mul(occlusion->clip, (vec4 *)model, clip);
+
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        // Every plane can add at most one corner to the polygon.
+        vec4 polygon[8], clipped[8];
+        int count = 3;
+        for (int k = 0; k < 3; ++k) {
+            const sf_vec3 p = vertices[indices[i + (size_t)k]].position;
+            glm_mat4_mulv(clip, (vec4){p.x, p.y, p.z, 1.0f}, polygon[k]);
+        }
+
+        for (int p = 0; p < 5 && count >= 3; ++p) {
+            int kept = 0;
+            for (int k = 0; k < count; ++k) {
+                const float *from = polygon[k], *to = polygon[(k + 1) % count];
+                const float *plane = planes[p];
+                const float d0 = plane[0] * from[0] + plane[1] * from[1] + plane[2] * from[2] + plane[3] * from[3];
+                const float d1 = plane[0] * to[0] + plane[1] * to[1] + plane[2] * to[2] + plane[3] * to[3];
+                if (d0 >= 0.0f)
+                    memcpy(clipped[kept++], from, sizeof(vec4));
+                if ((d0 >= 0.0f) != (d1 >= 0.0f)) {
+                    const float t = d0 / (d0 - d1);
+                    for (int c = 0; c < 4; ++c)
+                        clipped[kept][c] = from[c] + (to[c] - from[c]) * t;
+                    kept++;
+                }
+            }
+            memcpy(polygon, clipped, (size_t)kept * sizeof(vec4));
+            count = kept;
+        }
+        for (int k = 1; k + 1 < count; ++k)
+            sf_occlusion_emit(occlusion, polygon[0], polygon[k], polygon[k + 1]);
+    }
+}
+
+/// Pixels whose centers a triangle may cover, clamped to a rectangle. Returns false if there are none.
+static bool sf_occlusion_bounds(const sf_occlusion_triangle *t, const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, int32_t out[4]) {
+    const float min_x = fminf(fminf(t->x[0], t->x[1]), t->x[2]), max_x = fmaxf(fmaxf(t->x[0], t->x[1]), t->x[2]);
+    const float min_y = fminf(fminf(t->y[0], t->y[1]), t->y[2]), max_y = fmaxf(fmaxf(t->y[0], t->y[1]), t->y[2]);
+    // The guard band keeps these within a few screens of the buffer, so they fit an int.
+    out[0] = (int32_t)fmaxf(ceilf(min_x - 0.5f), (float)x0);
+    out[1] = (int32_t)fmaxf(ceilf(min_y - 0.5f), (float)y0);
+    out[2] = (int32_t)fminf(floorf(max_x - 0.5f), (float)x1);
+    out[3] = (int32_t)fminf(floorf(max_y - 0.5f), (float)y1);
+    return out[0] <= out[2] && out[1] <= out[3];
+}
+
+/// Draw a triangle's depth into the pixels of a rectangle, keeping the nearest depth of every pixel.
+/// Edge functions and depth are planes over the screen, evaluated four pixels at a time.
+static void sf_occlusion_rasterize(sf_occlusion *occlusion, const sf_occlusion_triangle *t, const int32_t rect[4]) {
+    float a[3], b[3], c[3];
+    for (int k = 0; k < 3; ++k) {
+        const int n = (k + 1) % 3;
+        a[k] = t->y[k] - t->y[n];
+        b[k] = t->x[n] - t->x[k];
+        c[k] = t->x[k] * t->y[n] - t->y[k] * t->x[n];
+    }
+    const float area = c[0] + c[1] + c[2];
+    const float dzdx = ((t->z[1] - t->z[0]) * (t->y[2] - t->y[0]) - (t->z[2] - t->z[0]) * (t->y[1] - t->y[0])) / area;
+    const float dzdy = ((t->z[2] - t->z[0]) * (t->x[1] - t->x[0]) - (t->z[1] - t->z[0]) * (t->x[2] - t->x[0])) / area;
+    const float dz = t->z[0] - dzdx * t->x[0] - dzdy * t->y[0];
+
+    const uint32_t width = occlusion->width;
+#if defined(__SSE2__)
+    // Tiles are a multiple of four pixels wide, so aligning down never leaves the tile.
+    const int32_t start = rect[0] & ~3;
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 ea0 = _mm_set1_ps(a[0]), ea1 = _mm_set1_ps(a[1]), ea2 = _mm_set1_ps(a[2]), za = _mm_set1_ps(dzdx);
+    const __m128 zero = _mm_setzero_ps();
+    for (int32_t y = rect[1]; y <= rect[3]; ++y) {
+        const float py = (float)y + 0.5f;
+        const __m128 e0 = _mm_set1_ps(b[0] * py + c[0]), e1 = _mm_set1_ps(b[1] * py + c[1]), e2 = _mm_set1_ps(b[2] * py + c[2]);
+        const __m128 z = _mm_set1_ps(dzdy * py + dz);
+        float *row = occlusion->depth + (size_t)y * width;
+        for (int32_t x = start; x <= rect[2]; x += 4) {
+            const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            const __m128 inside = _mm_and_ps(_mm_and_ps(
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea0, px), e0), zero),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea1, px), e1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ea2, px), e2), zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            const __m128 depth = _mm_loadu_ps(row + x);
+            const __m128 nearest = _mm_min_ps(depth, _mm_add_ps(_mm_mul_ps(za, px), z));
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, depth)));
+        }
+    }
+#else
+    for (int32_t y = rect[1]; y <= rect[3]; ++y) {
+        const float py = (float)y + 0.5f;
+        float *row = occlusion->depth + (size_t)y * width;
+        for (int32_t x = rect[0]; x <= rect[2]; ++x) {
+            const float px = (float)x + 0.5f;
+            if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                continue;
+            row[x] = fminf(row[x], dzdx * px + dzdy * py + dz);
+        }
+    }
+#endif
+}
+
+void sf_occlusion_finish(sf_occlusion *occlusion) {
+    const uint32_t tile = SF_OCCLUSION_TILE;
+    const uint32_t tiles_x = occlusion->width / tile, tiles_y = occlusion->height / tile;
+    const size_t tiles = (size_t)tiles_x * tiles_y;
+    const sf_occlusion_triangle *triangles = occlusion->triangles.data;
+    const size_t count = occlusion->triangles.count;
+    uint32_t *offsets = occlusion->bin_offsets;
+
+    // Bin triangles by the tiles their bounds touch, counting first so every bin is one range of an array.
+    memset(offsets, 0, (tiles + 1) * sizeof(uint32_t));
+    int32_t rect[4];
+    const int32_t last_x = (int32_t)occlusion->width - 1, last_y = (int32_t)occlusion->height - 1;
+    size_t binned = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!sf_occlusion_bounds(&triangles[i], 0, 0, last_x, last_y, rect))
+            continue;
+        for (int32_t ty = rect[1] / (int32_t)tile; ty <= rect[3] / (int32_t)tile; ++ty)
+            for (int32_t tx = rect[0] / (int32_t)tile; tx <= rect[2] / (int32_t)tile; ++tx) {
+                offsets[(size_t)ty * tiles_x + (size_t)tx + 1]++;
+                binned++;
+            }
+    }
+    if (binned > occlusion->bin_capacity) {
+        free(occlusion->bins);
+        occlusion->bin_capacity = binned * 2;
+        occlusion->bins = sf_malloc(occlusion->bin_capacity * sizeof(uint32_t));
+    }
+    for (size_t t = 0; t < tiles; ++t)
+        offsets[t + 1] += offsets[t];
+    // Fill each bin from its start, which leaves offsets[t] at the end of bin t, where bin t + 1 starts.
+    for (size_t i = 0; i < count; ++i) {
+        if (!sf_occlusion_bounds(&triangles[i], 0, 0, last_x, last_y, rect))
+            continue;
+        for (int32_t ty = rect[1] / (int32_t)tile; ty <= rect[3] / (int32_t)tile; ++ty)
+            for (int32_t tx = rect[0] / (int32_t)tile; tx <= rect[2] / (int32_t)tile; ++tx)
+                occlusion->bins[offsets[(size_t)ty * tiles_x + (size_t)tx]++] = (uint32_t)i;
+    }
+
+    // Rasterize a tile at a time, so its pixels stay in cache while every triangle over it is drawn.
+    for (uint32_t ty = 0; ty < tiles_y; ++ty)
+        for (uint32_t tx = 0; tx < tiles_x; ++tx) {
+            const size_t t = (size_t)ty * tiles_x + tx;
+            const uint32_t begin = t == 0 ? 0 : offsets[t - 1], end = offsets[t];
+            const int32_t x0 = (int32_t)(tx * tile), y0 = (int32_t)(ty * tile);
+            for (uint32_t i = begin; i < end; ++i)
+                if (sf_occlusion_bounds(&triangles[occlusion->bins[i]], x0, y0, x0 + (int32_t)tile - 1, y0 + (int32_t)tile - 1, rect))
+                    sf_occlusion_rasterize(occlusion, &triangles[occlusion->bins[i]], rect);
+        }
+
+    // Every texel of the pyramid keeps the farthest depth under it.
+    for (uint32_t level = 1; level < occlusion->levels; ++level) {
+        const float *src = occlusion->depth + occlusion->offsets[level - 1];
+        float *dst = occlusion->depth + occlusion->offsets[level];
+        const uint32_t src_w = occlusion->widths[level - 1], src_h = occlusion->heights[level - 1];
+        for (uint32_t y = 0; y < occlusion->heights[level]; ++y) {
+            const uint32_t y0 = y * 2, y1 = y0 + 1 < src_h ? y0 + 1 : y0;
+            for (uint32_t x = 0; x < occlusion->widths[level]; ++x) {
+                const uint32_t x0 = x * 2, x1 = x0 + 1 < src_w ? x0 + 1 : x0;
+                dst[(size_t)y * occlusion->widths[level] + x] = fmaxf(
+                    fmaxf(src[(size_t)y0 * src_w + x0], src[(size_t)y0 * src_w + x1]),
+                    fmaxf(src[(size_t)y1 * src_w + x0], src[(size_t)y1 * src_w + x1]));
+            }
+        }
+    }
+}
+
+/// The pixel a coordinate falls in, clamped to a buffer size pixels wide.
+static inline uint32_t sf_occlusion_pixel(const float x, const float size) {
+    return x <= 0.0f ? 0 : x >= size - 1.0f ? (uint32_t)size - 1 : (uint32_t)x;
+}
+
+bool sf_occlusion_test(sf_occlusion *occlusion, const sf_aabb box) {
+    occlusion->stats.tested++;
+    // Transform one corner, then reach the others by adding the clip space edges of the box.
+    // Plain comparisons from here on, fminf and fmaxf are library calls without fast math.
+    float min_x, min_y, min_z, max_x, max_y;
+#if defined(__SSE2__)
+    const __m128 m0 = _mm_loadu_ps(occlusion->clip[0]), m1 = _mm_loadu_ps(occlusion->clip[1]);
+    const __m128 m2 = _mm_loadu_ps(occlusion->clip[2]), m3 = _mm_loadu_ps(occlusion->clip[3]);
+    const __m128 e0 = _mm_mul_ps(m0, _mm_set1_ps(box.max.x - box.min.x));
+    const __m128 e1 = _mm_mul_ps(m1, _mm_set1_ps(box.max.y - box.min.y));
+    const __m128 e2 = _mm_mul_ps(m2, _mm_set1_ps(box.max.z - box.min.z));
+    __m128 c[8];
+    c[0] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, _mm_set1_ps(box.min.x)), _mm_mul_ps(m1, _mm_set1_ps(box.min.y))),
+        _mm_add_ps(_mm_mul_ps(m2, _mm_set1_ps(box.min.z)), m3));
+    c[1] = _mm_add_ps(c[0], e0);
+    c[2] = _mm_add_ps(c[0], e1);
+    c[3] = _mm_add_ps(c[1], e1);
+    for (int k = 0; k < 4; ++k)
+        c[k + 4] = _mm_add_ps(c[k], e2);
+    // Four corners per register of x, y, z and w.
+    _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+    _MM_TRANSPOSE4_PS(c[4], c[5], c[6], c[7]);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 behind = _mm_or_ps(
+        _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(c[2], c[3]), zero), _mm_cmple_ps(c[3], zero)),
+        _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(c[6], c[7]), zero), _mm_cmple_ps(c[7], zero)));
+    if (_mm_movemask_ps(behind))
+        return true;
+    const __m128 w0 = _mm_div_ps(_mm_set1_ps(1.0f), c[3]), w1 = _mm_div_ps(_mm_set1_ps(1.0f), c[7]);
+    const __m128 px0 = _mm_mul_ps(c[0], w0), px1 = _mm_mul_ps(c[4], w1);
+    const __m128 py0 = _mm_mul_ps(c[1], w0), py1 = _mm_mul_ps(c[5], w1);
+    const __m128 z = _mm_min_ps(_mm_mul_ps(c[2], w0), _mm_mul_ps(c[6], w1));
+    // Reduce min x, min y, min z, -max x and -max y across the lanes together.
+    __m128 lo0 = _mm_min_ps(px0, px1), lo1 = _mm_min_ps(py0, py1);
+    __m128 hi0 = _mm_max_ps(px0, px1), hi1 = _mm_max_ps(py0, py1);
+    _MM_TRANSPOSE4_PS(lo0, lo1, hi0, hi1);
+    const __m128 lo = _mm_min_ps(_mm_min_ps(lo0, lo1), _mm_min_ps(hi0, hi1));
+    const __m128 hi = _mm_max_ps(_mm_max_ps(lo0, lo1), _mm_max_ps(hi0, hi1));
+    float lows[4], highs[4], depths[4];
+    _mm_storeu_ps(lows, lo);
+    _mm_storeu_ps(highs, hi);
+    _mm_storeu_ps(depths, z);
+    min_x = lows[0]; min_y = lows[1]; max_x = highs[2]; max_y = highs[3];
+    min_z = depths[0];
+    for (int k = 1; k < 4; ++k)
+        min_z = depths[k] < min_z ? depths[k] : min_z;
+#else
+    const float (*m)[4] = occlusion->clip;
+    const float size[3] = {box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z};
+    float base[4], edges[3][4];
+    for (int r = 0; r < 4; ++r) {
+        base[r] = m[0][r] * box.min.x + m[1][r] * box.min.y + m[2][r] * box.min.z + m[3][r];
+        for (int axis = 0; axis < 3; ++axis)
+            edges[axis][r] = m[axis][r] * size[axis];
+    }
+    min_x = min_y = min_z = FLT_MAX;
+    max_x = max_y = -FLT_MAX;
+    for (int k = 0; k < 8; ++k) {
+        float c[4];
+        for (int r = 0; r < 4; ++r)
+            c[r] = base[r] + (k & 1 ? edges[0][r] : 0.0f) + (k & 2 ? edges[1][r] : 0.0f) + (k & 4 ? edges[2][r] : 0.0f);
+        if (c[2] < -c[3] || c[3] <= 0.0f)
+            return true;
+        const float w = 1.0f / c[3], x = c[0] * w, y = c[1] * w, z = c[2] * w;
+        min_x = x < min_x ? x : min_x; max_x = x > max_x ? x : max_x;
+        min_y = y < min_y ? y : min_y; max_y = y > max_y ? y : max_y;
+        min_z = z < min_z ? z : min_z;
+    }
+#endif
+    if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+        return true;
+
+    // Occluders only cover the pixels whose centers they contain, so widen the box by a pixel on every side:
+    // a gap between occluders that's at least a pixel wide then always has a sample under the box.
+    const float width = (float)occlusion->width, height = (float)occlusion->height;
+    uint32_t x0 = sf_occlusion_pixel((min_x * 0.5f + 0.5f) * width - 1.0f, width);
+    uint32_t y0 = sf_occlusion_pixel((min_y * 0.5f + 0.5f) * height - 1.0f, height);
+    uint32_t x1 = sf_occlusion_pixel((max_x * 0.5f + 0.5f) * width + 1.0f, width);
+    uint32_t y1 = sf_occlusion_pixel((max_y * 0.5f + 0.5f) * height + 1.0f, height);
+
+    // Go up the pyramid until the box touches at most 2x2 texels.
+    uint32_t level = 0;
+    while (level + 1 < occlusion->levels && (x1 - x0 > 1 || y1 - y0 > 1)) {
+        x0 >>= 1; y0 >>= 1; x1 >>= 1; y1 >>= 1;
+        level++;
+    }
+    const float *depth = occlusion->depth + occlusion->offsets[level];
+    float farthest = 0.0f;
+    for (uint32_t y = y0; y <= y1; ++y)
+        for (uint32_t x = x0; x <= x1; ++x)
+            if (depth[(size_t)y * occlusion->widths[level] + x] > farthest)
+                farthest = depth[(size_t)y * occlusion->widths[level] + x];
+
+    if (min_z * 0.5f + 0.5f > farthest) {
+        occlusion->stats.culled++;
+        return false;
+    }
+    return true;
+}
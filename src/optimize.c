@@ -0,0 +1,317 @@
+#include "sf/optimize.h"
+
+#include <math.h>
+
+/// Smallest number of triangles in an overdraw cluster, smaller clusters would cost too much vertex cache reuse.
+#define SF_OPTIMIZE_CLUSTER_MIN 64
+/// How much worse than the whole mesh's a cluster's vertex cache miss ratio may be when splitting for overdraw.
+#define SF_OPTIMIZE_CLUSTER_THRESHOLD 1.05f
+/// Cache slots past SF_OPTIMIZE_CACHE_SIZE, so the three vertices of a new triangle can push out old ones before they're dropped.
+#define SF_OPTIMIZE_CACHE_SLACK 3
+
+/// Simulate a fifo cache over an index buffer, returning the number of vertices that missed.
+/// Vertices are stamped with the miss count when they're loaded, they're cached until cache_size more misses happen.
+static size_t sf_cache_simulate(const int32_t *indices, const size_t triangles, const size_t vertex_count, const size_t cache_size) {
+    uint32_t *stamps = sf_calloc(vertex_count, sizeof(uint32_t));
+    size_t misses = 0, time = cache_size + 1;
+    for (size_t i = 0; i < triangles * 3; ++i)
+        if (time - stamps[indices[i]] > cache_size) {
+            stamps[indices[i]] = (uint32_t)time++;
+            misses++;
+        }
+    free(stamps);
+    return misses;
+}
+
+sf_vertex_cache_stats sf_mesh_analyze(const sf_mesh *mesh, const size_t cache_size) {
+    const size_t triangles = mesh->indices.count / 3;
+    if (triangles == 0 || mesh->vertices.count == 0 || cache_size == 0)
+        return (sf_vertex_cache_stats){};
+    const size_t misses = sf_cache_simulate(mesh->indices.data, triangles, mesh->vertices.count, cache_size);
+    return (sf_vertex_cache_stats){
+        .acmr = (float)misses / (float)triangles,
+        .atvr = (float)misses / (float)mesh->vertices.count,
+    };
+}
+
+/// Forsyth's vertex score: vertices just used score a flat bonus, then decay with their position in the cache.
+/// Vertices with few triangles left score higher so they're finished off instead of left stranded.
+static float sf_vertex_score(const int32_t position, const uint32_t live) {
+    if (live == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (position >= 0) {
+        if (position < 3)
+            score = 0.75f;
+        else {
+            const float scale = 1.0f / (SF_OPTIMIZE_CACHE_SIZE - 3);
+            score = powf(1.0f - (float)(position - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f * powf((float)live, -0.5f);
+}
+
+/// Reorder triangles for a least recently used cache of SF_OPTIMIZE_CACHE_SIZE entries, writing them to out.
+static void sf_optimize_cache(const int32_t *indices, const size_t triangles, const size_t vertex_count, int32_t *out) {
+    // Triangles of each vertex, the first live[v] of them are still to be emitted.
+    uint32_t *offsets = sf_malloc((vertex_count + 1) * sizeof(uint32_t));
+    uint32_t *live = sf_calloc(vertex_count, sizeof(uint32_t));
+    uint32_t *adjacency = sf_malloc(triangles * 3 * sizeof(uint32_t));
+    for (size_t i = 0; i < triangles * 3; ++i)
+        live[indices[i]]++;
+    offsets[0] = 0;
+    for (size_t v = 0; v < vertex_count; ++v)
+        offsets[v + 1] = offsets[v] + live[v];
+    for (size_t v = 0; v < vertex_count; ++v)
+        live[v] = 0;
+    for (size_t t = 0; t < triangles; ++t)
+        for (size_t k = 0; k < 3; ++k) {
+            const int32_t v = indices[t * 3 + k];
+            adjacency[offsets[v] + live[v]++] = (uint32_t)t;
+        }
+
+    int32_t *position = sf_malloc(vertex_count * sizeof(int32_t));
+    float *vertex_scores = sf_malloc(vertex_count * sizeof(float));
+    for (size_t v = 0; v < vertex_count; ++v) {
+        position[v] = -1;
+        vertex_scores[v] = sf_vertex_score(-1, live[v]);
+    }
+    float *scores = sf_malloc(triangles * sizeof(float));
+    bool *emitted = sf_calloc(triangles, sizeof(bool));
+    for (size_t t = 0; t < triangles; ++t)
+        scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+
+    int32_t cache[SF_OPTIMIZE_CACHE_SIZE + SF_OPTIMIZE_CACHE_SLACK], next[SF_OPTIMIZE_CACHE_SIZE + SF_OPTIMIZE_CACHE_SLACK];
+    size_t cached = 0, scan = 0, written = 0;
+    int64_t best = 0;
+    float best_score = scores[0];
+    for (size_t t = 1; t < triangles; ++t)
+        if (scores[t] > best_score) {
+            best_score = scores[t];
+            best = (int64_t)t;
+        }
+
+    while (best >= 0) {
+        const size_t t = (size_t)best;
+        emitted[t] = true;
+        for (size_t k = 0; k < 3; ++k)
+            out[written++] = indices[t * 3 + k];
+
+        // Move the triangle's vertices to the front of the cache, dropping it from their live lists.
+        size_t count = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            const int32_t v = indices[t * 3 + k];
+            next[count++] = v;
+            uint32_t *list = adjacency + offsets[v];
+            for (uint32_t i = 0; i < live[v]; ++i)
+                if (list[i] == t) {
+                    list[i] = list[--live[v]];
+                    break;
+                }
+        }
+        for (size_t i = 0; i < cached; ++i) {
+            const int32_t v = cache[i];
+            if (v != indices[t * 3] && v != indices[t * 3 + 1] && v != indices[t * 3 + 2])
+                next[count++] = v;
+        }
+        cached = count < SF_OPTIMIZE_CACHE_SIZE ? count : SF_OPTIMIZE_CACHE_SIZE;
+        for (size_t i = cached; i < count; ++i)
+            position[next[i]] = -1;
+        for (size_t i = 0; i < cached; ++i) {
+            cache[i] = next[i];
+            position[next[i]] = (int32_t)i;
+        }
+
+        // Rescore everything whose cache position changed, only triangles around those vertices can become the best.
+        for (size_t i = 0; i < count; ++i) {
+            const int32_t v = next[i];
+            const float score = sf_vertex_score(position[v], live[v]);
+            const float change = score - vertex_scores[v];
+            vertex_scores[v] = score;
+            for (uint32_t j = 0; j < live[v]; ++j)
+                scores[adjacency[offsets[v] + j]] += change;
+        }
+        best = -1;
+        best_score = -1.0f;
+        for (size_t i = 0; i < cached; ++i) {
+            const int32_t v = cache[i];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                const uint32_t candidate = adjacency[offsets[v] + j];
+                if (scores[candidate] > best_score) {
+                    best_score = scores[candidate];
+                    best = candidate;
+                }
+            }
+        }
+
+        // Dead end, nothing in the cache has triangles left, so continue from the next triangle not yet emitted.
+        if (best < 0) {
+            while (scan < triangles && emitted[scan])
+                scan++;
+            if (scan < triangles)
+                best = (int64_t)scan;
+        }
+    }
+
+    free(offsets);
+    free(live);
+    free(adjacency);
+    free(position);
+    free(vertex_scores);
+    free(scores);
+    free(emitted);
+}
+
+/// A run of consecutive triangles that's moved as a whole when reordering for overdraw.
+typedef struct {
+    size_t first, count;
+    vec3 center, normal; /// Area weighted centroid and average normal.
+    float sort;
+} sf_cluster;
+
+static int sf_cluster_compare(const void *a, const void *b) {
+    const float x = ((const sf_cluster *)a)->sort, y = ((const sf_cluster *)b)->sort;
+    return (x < y) - (x > y);
+}
+
+/// Split cache optimized triangles into clusters where the cache was flushed anyway, and draw the clusters facing
+/// out of the mesh first. Whichever way the mesh is seen from, its outer surfaces then tend to be drawn before the
+/// ones they hide, so early depth testing rejects more fragments. Returns the number of clusters.
+static size_t sf_optimize_overdraw(int32_t *indices, const size_t triangles, const sf_vertex *vertices, const size_t vertex_count) {
+    // Every cluster starts with a cold cache once they're shuffled, so each one is simulated from scratch.
+    // A cluster ends as soon as its own miss ratio is within SF_OPTIMIZE_CLUSTER_THRESHOLD of the whole mesh's,
+    // or right before a triangle that misses all of its vertices anyway, which is where the cache order hit a dead end.
+    const float threshold = (float)sf_cache_simulate(indices, triangles, vertex_count, SF_ANALYZE_CACHE_SIZE) / (float)triangles * SF_OPTIMIZE_CLUSTER_THRESHOLD;
+    uint32_t *stamps = sf_calloc(vertex_count, sizeof(uint32_t));
+    sf_cluster *clusters = sf_malloc(triangles * sizeof(sf_cluster));
+    size_t cluster_count = 0, misses = 0, time = SF_ANALYZE_CACHE_SIZE + 1;
+    for (size_t t = 0; t < triangles; ++t) {
+        size_t missed = 0;
+        for (size_t k = 0; k < 3; ++k)
+            missed += time - stamps[indices[t * 3 + k]] > SF_ANALYZE_CACHE_SIZE;
+        if (cluster_count == 0 || (missed == 3 && clusters[cluster_count - 1].count >= SF_OPTIMIZE_CLUSTER_MIN)) {
+            clusters[cluster_count++] = (sf_cluster){ .first = t };
+            time += SF_ANALYZE_CACHE_SIZE + 1;
+            misses = 0;
+        }
+        for (size_t k = 0; k < 3; ++k)
+            if (time - stamps[indices[t * 3 + k]] > SF_ANALYZE_CACHE_SIZE) {
+                stamps[indices[t * 3 + k]] = (uint32_t)time++;
+                misses++;
+            }
+        sf_cluster *cluster = &clusters[cluster_count - 1];
+        cluster->count++;
+        // Starting the next cluster here costs little, the cold start is already paid for in this one's ratio.
+        if (cluster->count >= SF_OPTIMIZE_CLUSTER_MIN && t + 1 < triangles && (float)misses <= threshold * (float)cluster->count) {
+            clusters[cluster_count++] = (sf_cluster){ .first = t + 1 };
+            time += SF_ANALYZE_CACHE_SIZE + 1;
+            misses = 0;
+        }
+    }
+    free(stamps);
+    if (cluster_count < 2) {
+        free(clusters);
+        return cluster_count;
+    }
+
+    // Weight everything by area, so densely tesselated regions don't pull the centroids around.
+    vec3 mesh_center = GLM_VEC3_ZERO_INIT;
+    float mesh_area = 0.0f;
+    for (size_t i = 0; i < cluster_count; ++i) {
+        sf_cluster *cluster = &clusters[i];
+        float area = 0.0f;
+        for (size_t t = cluster->first; t < cluster->first + cluster->count; ++t) {
+            const sf_vec3 a = vertices[indices[t * 3]].position, b = vertices[indices[t * 3 + 1]].position, c = vertices[indices[t * 3 + 2]].position;
+            vec3 ab = { b.x - a.x, b.y - a.y, b.z - a.z }, ac = { c.x - a.x, c.y - a.y, c.z - a.z }, cross;
+            glm_vec3_cross(ab, ac, cross);
+            const float weight = glm_vec3_norm(cross) * 0.5f;
+            vec3 centroid = { (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f };
+            glm_vec3_muladds(centroid, weight, cluster->center);
+            glm_vec3_add(cluster->normal, cross, cluster->normal);
+            area += weight;
+        }
+        glm_vec3_add(mesh_center, cluster->center, mesh_center);
+        mesh_area += area;
+        if (area > 0.0f)
+            glm_vec3_scale(cluster->center, 1.0f / area, cluster->center);
+        glm_vec3_normalize(cluster->normal);
+    }
+    if (mesh_area > 0.0f)
+        glm_vec3_scale(mesh_center, 1.0f / mesh_area, mesh_center);
+
+    // Clusters far out along their own normal are on the outside, facing away from the rest of the mesh.
+    for (size_t i = 0; i < cluster_count; ++i) {
+        vec3 offset;
+        glm_vec3_sub(clusters[i].center, mesh_center, offset);
+        clusters[i].sort = glm_vec3_dot(offset, clusters[i].normal);
+    }
+    qsort(clusters, cluster_count, sizeof(sf_cluster), sf_cluster_compare);
+
+    int32_t *sorted = sf_malloc(triangles * 3 * sizeof(int32_t));
+    size_t written = 0;
+    for (size_t i = 0; i < cluster_count; ++i) {
+        memcpy(sorted + written, indices + clusters[i].first * 3, clusters[i].count * 3 * sizeof(int32_t));
+        written += clusters[i].count * 3;
+    }
+    memcpy(indices, sorted, triangles * 3 * sizeof(int32_t));
+    free(sorted);
+    free(clusters);
+    return cluster_count;
+}
+
+/// Renumber vertices in the order the indices first use them, so the gpu fetches vertex memory sequentially.
+/// Vertices no triangle uses keep their relative order at the end. The weld table is kept pointing at the right vertices.
+static void sf_optimize_fetch(sf_mesh *mesh) {
+    const size_t vertex_count = mesh->vertices.count;
+    int32_t *remap = sf_malloc(vertex_count * sizeof(int32_t));
+    for (size_t v = 0; v < vertex_count; ++v)
+        remap[v] = -1;
+    int32_t *indices = mesh->indices.data;
+    int32_t next = 0;
+    for (size_t i = 0; i < mesh->indices.count; ++i) {
+        if (remap[indices[i]] < 0)
+            remap[indices[i]] = next++;
+        indices[i] = remap[indices[i]];
+    }
+    for (size_t v = 0; v < vertex_count; ++v)
+        if (remap[v] < 0)
+            remap[v] = next++;
+
+    sf_vertex *vertices = mesh->vertices.data;
+    sf_vertex *sorted = sf_malloc(vertex_count * sizeof(sf_vertex));
+    for (size_t v = 0; v < vertex_count; ++v)
+        sorted[remap[v]] = vertices[v];
+    memcpy(vertices, sorted, vertex_count * sizeof(sf_vertex));
+    free(sorted);
+
+    // Vertex contents didn't change, so every slot keeps its hash and place in the table.
+    for (size_t i = 0; i < mesh->cache.capacity; ++i)
+        if (mesh->cache.slots[i].index >= 0)
+            mesh->cache.slots[i].index = remap[mesh->cache.slots[i].index];
+    free(remap);
+}
+
+sf_optimize_stats sf_mesh_optimize(sf_mesh *mesh) {
+    const size_t triangles = mesh->indices.count / 3, vertex_count = mesh->vertices.count;
+    sf_optimize_stats stats = {
+        .before = sf_mesh_analyze(mesh, SF_ANALYZE_CACHE_SIZE),
+    };
+    if (triangles == 0) {
+        stats.after = stats.before;
+        return stats;
+    }
+
+    // A trailing partial triangle isn't drawn, it stays where it is.
+    int32_t *indices = mesh->indices.data;
+    int32_t *ordered = sf_malloc(triangles * 3 * sizeof(int32_t));
+    sf_optimize_cache(indices, triangles, vertex_count, ordered);
+    memcpy(indices, ordered, triangles * 3 * sizeof(int32_t));
+    free(ordered);
+    stats.clusters = sf_optimize_overdraw(indices, triangles, mesh->vertices.data, vertex_count);
+    sf_optimize_fetch(mesh);
+
+    mesh->dirty_vertices = (sf_mesh_range){0, vertex_count};
+    mesh->dirty_indices = (sf_mesh_range){0, mesh->indices.count};
+    stats.after = sf_mesh_analyze(mesh, SF_ANALYZE_CACHE_SIZE);
+    return stats;
+}
@@ -0,0 +1,487 @@
+#include "sf/pool.h"
+
+#include "sf/state.h"
+#include "sf/stream.h"
+#include "util.h"
+
+#define SF_BUDDY_NONE UINT32_MAX
+#define SF_BUDDY_TAKEN UINT8_MAX
+
+static void sf_buddy_push(sf_buddy *buddy, const uint32_t block, const uint8_t order) {
+    buddy->order[block] = order;
+    buddy->prev[block] = SF_BUDDY_NONE;
+    buddy->next[block] = buddy->heads[order];
+    if (buddy->heads[order] != SF_BUDDY_NONE)
+        buddy->prev[buddy->heads[order]] = block;
+    buddy->heads[order] = block;
+}
+
+static void sf_buddy_unlink(sf_buddy *buddy, const uint32_t block) {
+    const uint8_t order = buddy->order[block];
+    if (buddy->prev[block] != SF_BUDDY_NONE)
+        buddy->next[buddy->prev[block]] = buddy->next[block];
+    else buddy->heads[order] = buddy->next[block];
+    if (buddy->next[block] != SF_BUDDY_NONE)
+        buddy->prev[buddy->next[block]] = buddy->prev[block];
+    buddy->order[block] = SF_BUDDY_TAKEN;
+}
+
+/// Free a block, merging it with its buddy for as long as the buddy is free too.
+static void sf_buddy_release(sf_buddy *buddy, uint32_t block, uint8_t order) {
+    while (order + 1 < buddy->orders) {
+        const uint32_t other = block ^ (1u << order);
+        if (buddy->order[other] != order)
+            break;
+        sf_buddy_unlink(buddy, other);
+        block &= ~(1u << order);
+        order++;
+    }
+    sf_buddy_push(buddy, block, order);
+}
+
+/// Double the number of blocks, the new upper half starts out free.
+static void sf_buddy_grow(sf_buddy *buddy) {
+    const uint32_t old = buddy->blocks;
+    buddy->blocks = old ? old * 2 : 1;
+    buddy->orders++;
+    buddy->next = sf_grow(buddy->next, buddy->blocks * sizeof(uint32_t));
+    buddy->prev = sf_grow(buddy->prev, buddy->blocks * sizeof(uint32_t));
+    buddy->order = sf_grow(buddy->order, buddy->blocks * sizeof(uint8_t));
+    memset(buddy->order + old, SF_BUDDY_TAKEN, buddy->blocks - old);
+    sf_buddy_release(buddy, old, (uint8_t)(buddy->orders - (old ? 2 : 1)));
+}
+
+static sf_buddy sf_buddy_new(const size_t blocks) {
+    sf_buddy buddy = {};
+    for (int i = 0; i < SF_BUDDY_MAX_ORDERS; ++i)
+        buddy.heads[i] = SF_BUDDY_NONE;
+    while (buddy.blocks < blocks)
+        sf_buddy_grow(&buddy);
+    return buddy;
+}
+
+static void sf_buddy_delete(sf_buddy *buddy) {
+    free(buddy->next);
+    free(buddy->prev);
+    free(buddy->order);
+    *buddy = (sf_buddy){};
+}
+
+/// The order of the smallest block holding count elements.
+static uint8_t sf_buddy_order(const size_t count) {
+    const size_t blocks = count ? (count + SF_POOL_BLOCK - 1) / SF_POOL_BLOCK : 1;
+    uint8_t order = 0;
+    while (((size_t)1 << order) < blocks)
+        order++;
+    return order;
+}
+
+/// Take a block of the requested order, splitting a bigger one if there's none.
+/// Returns SF_BUDDY_NONE if nothing big enough is free.
+static uint32_t sf_buddy_alloc(sf_buddy *buddy, const uint8_t order) {
+    uint8_t o = order;
+    while (o < buddy->orders && buddy->heads[o] == SF_BUDDY_NONE)
+        o++;
+    if (o >= buddy->orders)
+        return SF_BUDDY_NONE;
+
+    const uint32_t block = buddy->heads[o];
+    sf_buddy_unlink(buddy, block);
+    while (o > order) {
+        o--;
+        sf_buddy_push(buddy, block + (1u << o), o);
+    }
+    return block;
+}
+
+typedef enum {
+    SF_POOL_VERTICES,
+    SF_POOL_INDICES,
+} sf_pool_part;
+
+static sf_buddy *sf_pool_blocks(sf_mesh_pool *pool, const sf_pool_part part) {
+    return part == SF_POOL_VERTICES ? &pool->vertex_blocks : &pool->index_blocks;
+}
+static GLuint *sf_pool_buffer(sf_mesh_pool *pool, const sf_pool_part part) {
+    return part == SF_POOL_VERTICES ? &pool->vbo : &pool->ebo;
+}
+static size_t sf_pool_element_size(const sf_mesh_pool *pool, const sf_pool_part part) {
+    return part == SF_POOL_VERTICES ? pool->layout.stride : sizeof(int32_t);
+}
+static sf_pool_range *sf_pool_entry_range(sf_pool_entry *entry, const sf_pool_part part) {
+    return part == SF_POOL_VERTICES ? &entry->vertices : &entry->indices;
+}
+
+/// Create a buffer of size bytes, copying the first keep bytes of the old buffer over and deleting it.
+static GLuint sf_pool_replace_buffer(const GLuint old, const size_t keep, const size_t size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, GL_STATIC_DRAW);
+    if (old) {
+        if (keep) {
+            sf_gl_bind_buffer(GL_COPY_READ_BUFFER, old);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)keep);
+        }
+        sf_gl_forget_buffer(old);
+        glDeleteBuffers(1, &old);
+    }
+    return buffer;
+}
+
+/// Point the pool's vertex array at its current buffers.
+static void sf_pool_attach(const sf_mesh_pool *pool) {
+    sf_gl_bind_vertex_array(pool->vao);
+    sf_gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->ebo);
+    sf_vertex_attributes(&pool->layout, pool->vbo);
+}
+
+/// Allocate a range for count elements, growing the buffer until it fits.
+static uint32_t sf_pool_allocate(sf_mesh_pool *pool, const sf_pool_part part, const size_t count) {
+    sf_buddy *blocks = sf_pool_blocks(pool, part);
+    const uint8_t order = sf_buddy_order(count);
+    uint32_t block;
+    while ((block = sf_buddy_alloc(blocks, order)) == SF_BUDDY_NONE) {
+        const size_t element_size = sf_pool_element_size(pool, part);
+        const size_t kept = blocks->blocks * SF_POOL_BLOCK * element_size;
+        sf_buddy_grow(blocks);
+        GLuint *buffer = sf_pool_buffer(pool, part);
+        *buffer = sf_pool_replace_buffer(*buffer, kept, blocks->blocks * SF_POOL_BLOCK * element_size);
+        sf_pool_attach(pool);
+    }
+    return block * SF_POOL_BLOCK;
+}
+
+static void sf_pool_free(sf_mesh_pool *pool, const sf_pool_part part, const sf_pool_range range) {
+    sf_buddy_release(sf_pool_blocks(pool, part), range.first / SF_POOL_BLOCK, sf_buddy_order(range.count));
+}
+
+static void sf_pool_write(const GLuint buffer, const size_t offset, const void *data, const size_t size) {
+    if (size == 0)
+        return;
+    // Written through the array target, binding the element target would change the bound vertex array.
+    sf_gl_bind_buffer(GL_ARRAY_BUFFER, buffer);
+    sf_stream *stream = sf_stream_current();
+    if (!stream || !sf_stream_copy(stream, GL_ARRAY_BUFFER, (GLintptr)offset, data, size))
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data);
+}
+
+sf_mesh_pool sf_mesh_pool_new(const sf_vertex_layout layout, const size_t vertex_capacity, const size_t index_capacity) {
+    // At least one block each, so neither buffer starts out empty.
+    sf_mesh_pool pool = {
+        .layout = layout,
+        .vertex_blocks = sf_buddy_new(vertex_capacity ? (vertex_capacity + SF_POOL_BLOCK - 1) / SF_POOL_BLOCK : 1),
+        .index_blocks = sf_buddy_new(index_capacity ? (index_capacity + SF_POOL_BLOCK - 1) / SF_POOL_BLOCK : 1),
+        .free_entry = -1,
+    };
+
+    glGenVertexArrays(1, &pool.vao);
+    glGenBuffers(1, &pool.ibo);
+    pool.vbo = sf_pool_replace_buffer(0, 0, pool.vertex_blocks.blocks * SF_POOL_BLOCK * layout.stride);
+    pool.ebo = sf_pool_replace_buffer(0, 0, pool.index_blocks.blocks * SF_POOL_BLOCK * sizeof(int32_t));
+
+    sf_pool_attach(&pool);
+    sf_instance_attributes(pool.ibo);
+    pool.ibo_capacity = 1;
+
+    sf_opengl_log();
+
+    return pool;
+}
+
+void sf_mesh_pool_delete(sf_mesh_pool *pool) {
+    sf_buddy_delete(&pool->vertex_blocks);
+    sf_buddy_delete(&pool->index_blocks);
+    free(pool->entries);
+
+    sf_gl_forget_vertex_array(pool->vao);
+    sf_gl_forget_buffer(pool->vbo);
+    sf_gl_forget_buffer(pool->ebo);
+    sf_gl_forget_buffer(pool->ibo);
+    glDeleteVertexArrays(1, &pool->vao);
+    glDeleteBuffers(1, &pool->vbo);
+    glDeleteBuffers(1, &pool->ebo);
+    glDeleteBuffers(1, &pool->ibo);
+    *pool = (sf_mesh_pool){ .free_entry = -1 };
+}
+
+sf_pool_handle sf_mesh_pool_add(sf_mesh_pool *pool, const sf_vertex *vertices, const size_t vertex_count, const int32_t *indices, const size_t index_count) {
+    sf_pool_handle handle = pool->free_entry;
+    if (handle >= 0) {
+        pool->free_entry = pool->entries[handle].next_free;
+    } else {
+        if (pool->entry_count == pool->entry_capacity) {
+            pool->entry_capacity = pool->entry_capacity ? pool->entry_capacity * 2 : 64;
+            pool->entries = sf_grow(pool->entries, pool->entry_capacity * sizeof(sf_pool_entry));
+        }
+        handle = (sf_pool_handle)pool->entry_count++;
+    }
+
+    sf_pool_entry *entry = &pool->entries[handle];
+    *entry = (sf_pool_entry){
+        .vertices = { sf_pool_allocate(pool, SF_POOL_VERTICES, vertex_count), (uint32_t)vertex_count },
+        .indices = { sf_pool_allocate(pool, SF_POOL_INDICES, index_count), (uint32_t)index_count },
+        .bounds = sf_bounds_compute(vertices, vertex_count),
+        .next_free = SF_POOL_USED,
+    };
+    sf_gl_bind_buffer(GL_ARRAY_BUFFER, pool->vbo);
+    sf_vertex_upload(&pool->layout, GL_ARRAY_BUFFER, (GLintptr)(entry->vertices.first * pool->layout.stride), vertices, vertex_count);
+    sf_pool_write(pool->ebo, entry->indices.first * sizeof(int32_t), indices, index_count * sizeof(int32_t));
+    return handle;
+}
+
+static bool sf_pool_valid(const sf_mesh_pool *pool, const sf_pool_handle mesh) {
+    return mesh >= 0 && (size_t)mesh < pool->entry_count && pool->entries[mesh].next_free == SF_POOL_USED;
+}
+
+void sf_mesh_pool_remove(sf_mesh_pool *pool, const sf_pool_handle mesh) {
+    if (!sf_pool_valid(pool, mesh))
+        return;
+    sf_pool_entry *entry = &pool->entries[mesh];
+    sf_pool_free(pool, SF_POOL_VERTICES, entry->vertices);
+    sf_pool_free(pool, SF_POOL_INDICES, entry->indices);
+    entry->next_free = pool->free_entry;
+    pool->free_entry = mesh;
+}
+
+typedef struct {
+    uint8_t order;
+    sf_pool_handle mesh;
+} sf_pool_order;
+
+static int sf_pool_order_compare(const void *a, const void *b) {
+    const sf_pool_order *x = a, *y = b;
+    if (x->order != y->order)
+        return x->order > y->order ? -1 : 1;
+    return (x->mesh > y->mesh) - (x->mesh < y->mesh);
+}
+
+/// Move every live range of one buffer into a fresh buffer of the same size.
+/// Handing out blocks in decreasing size makes a buddy allocator pack them without gaps.
+static void sf_pool_repack(sf_mesh_pool *pool, const sf_pool_part part, sf_pool_order *order, const size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        order[i].order = sf_buddy_order(sf_pool_entry_range(&pool->entries[order[i].mesh], part)->count);
+    qsort(order, count, sizeof(sf_pool_order), sf_pool_order_compare);
+
+    sf_buddy *blocks = sf_pool_blocks(pool, part);
+    sf_buddy packed = sf_buddy_new(blocks->blocks);
+    const size_t element_size = sf_pool_element_size(pool, part);
+    GLuint *buffer = sf_pool_buffer(pool, part);
+    const GLuint old = *buffer;
+    *buffer = sf_pool_replace_buffer(0, 0, blocks->blocks * SF_POOL_BLOCK * element_size);
+
+    sf_gl_bind_buffer(GL_COPY_READ_BUFFER, old);
+    sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, *buffer);
+    for (size_t i = 0; i < count; ++i) {
+        sf_pool_range *range = sf_pool_entry_range(&pool->entries[order[i].mesh], part);
+        const uint32_t first = sf_buddy_alloc(&packed, order[i].order) * SF_POOL_BLOCK;
+        if (range->count)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                (GLintptr)(range->first * element_size), (GLintptr)(first * element_size),
+                (GLsizeiptr)(range->count * element_size));
+        range->first = first;
+    }
+
+    sf_gl_forget_buffer(old);
+    glDeleteBuffers(1, &old);
+    sf_buddy_delete(blocks);
+    *blocks = packed;
+}
+
+void sf_mesh_pool_compact(sf_mesh_pool *pool) {
+    sf_pool_order *order = sf_malloc((pool->entry_count ? pool->entry_count : 1) * sizeof(sf_pool_order));
+    size_t count = 0;
+    for (size_t i = 0; i < pool->entry_count; ++i)
+        if (pool->entries[i].next_free == SF_POOL_USED)
+            order[count++] = (sf_pool_order){0, (sf_pool_handle)i};
+
+    sf_pool_repack(pool, SF_POOL_VERTICES, order, count);
+    sf_pool_repack(pool, SF_POOL_INDICES, order, count);
+    sf_pool_attach(pool);
+    free(order);
+}
+
+sf_result sf_mesh_pool_draw(sf_mesh_pool *pool, const sf_pool_handle mesh, sf_shader *shader, sf_camera *camera, const sf_transform transform, const sf_texture *texture) {
+    mat4 model;
+    sf_transform_model(model, transform);
+    return sf_mesh_pool_draw_matrix(pool, mesh, shader, camera, model, texture);
+}
+
+sf_result sf_mesh_pool_draw_matrix(sf_mesh_pool *pool, const sf_pool_handle mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture) {
+    if (!sf_pool_valid(pool, mesh))
+        return sf_err(sf_str_fmt("Mesh %d isn't in the pool.", mesh));
+    const sf_pool_entry *entry = &pool->entries[mesh];
+
+    sf_camera_update(camera);
+    if (!sf_frustum_test_sphere(&camera->frustum, sf_sphere_transform(entry->bounds.sphere, model)))
+        return sf_ok();
+    sf_shader_bind(shader);
+    if (shader->builtin.model == SF_UNIFORM_NONE)
+        return sf_err(sf_lit("Uniform 'm_model' not found."));
+    const sf_result res = sf_camera_bind(camera);
+    if (!res.ok)
+        return res;
+
+    sf_shader_set_mat4(shader, shader->builtin.model, model);
+
+    sf_gl_bind_framebuffer(camera->framebuffer);
+    sf_gl_active_texture(0);
+    sf_gl_bind_texture(texture->handle);
+    sf_gl_bind_vertex_array(pool->vao);
+    sf_instance_identity();
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)entry->indices.count, GL_UNSIGNED_INT,
+        (void*)(entry->indices.first * sizeof(int32_t)), (GLint)entry->vertices.first);
+
+    return sf_ok();
+}
+
+sf_pool_batch sf_pool_batch_new() {
+    sf_pool_batch batch = {
+        .commands = sf_vec_new(sf_draw_command),
+        .models = sf_vec_new(mat4),
+        .spheres = sf_vec_new(sf_sphere),
+    };
+    glGenBuffers(1, &batch.indirect);
+    return batch;
+}
+
+void sf_pool_batch_delete(sf_pool_batch *batch) {
+    sf_vec_delete(&batch->commands);
+    sf_vec_delete(&batch->models);
+    sf_vec_delete(&batch->spheres);
+    sf_gl_forget_buffer(batch->indirect);
+    glDeleteBuffers(1, &batch->indirect);
+    batch->indirect = 0;
+}
+
+void sf_pool_batch_push(sf_pool_batch *batch, const sf_mesh_pool *pool, const sf_pool_handle mesh, const sf_transform transform) {
+    mat4 model;
+    sf_transform_model(model, transform);
+    sf_pool_batch_push_matrix(batch, pool, mesh, model);
+}
+
+void sf_pool_batch_push_matrix(sf_pool_batch *batch, const sf_mesh_pool *pool, const sf_pool_handle mesh, const mat4 model) {
+    if (!sf_pool_valid(pool, mesh))
+        return;
+    const sf_pool_entry *entry = &pool->entries[mesh];
+    sf_vec_push(&batch->models, model);
+    const sf_sphere sphere = sf_sphere_transform(entry->bounds.sphere, model);
+    sf_vec_push(&batch->spheres, &sphere);
+
+    if (batch->commands.count > 0) {
+        sf_draw_command *last = (sf_draw_command *)batch->commands.data + batch->commands.count - 1;
+        if (last->first_index == entry->indices.first && last->base_vertex == (int32_t)entry->vertices.first) {
+            last->instance_count++;
+            return;
+        }
+    }
+    sf_vec_push(&batch->commands, &(sf_draw_command){
+        .count = entry->indices.count,
+        .instance_count = 1,
+        .first_index = entry->indices.first,
+        .base_vertex = (int32_t)entry->vertices.first,
+        .base_instance = (uint32_t)batch->models.count - 1,
+    });
+}
+
+void sf_pool_batch_clear(sf_pool_batch *batch) {
+    batch->commands.count = 0;
+    batch->models.count = 0;
+    batch->spheres.count = 0;
+}
+
+#define SF_POOL_CULL_BATCH 64
+/// Drop the draws outside a frustum, packing the models of the rest to the front.
+/// Every command keeps its visible instances in order, commands left with none are removed.
+static void sf_pool_batch_cull(sf_pool_batch *batch, const sf_frustum *frustum) {
+    sf_draw_command *commands = batch->commands.data;
+    mat4 *models = batch->models.data;
+    const sf_sphere *spheres = batch->spheres.data;
+    uint32_t visible[SF_POOL_CULL_BATCH];
+    size_t kept_commands = 0, kept_models = 0;
+    for (size_t c = 0; c < batch->commands.count; ++c) {
+        sf_draw_command command = commands[c];
+        const size_t first = kept_models;
+        // Models only ever move towards the front, so nothing is overwritten before it's read.
+        for (size_t base = 0; base < command.instance_count; base += SF_POOL_CULL_BATCH) {
+            const size_t n = command.instance_count - base < SF_POOL_CULL_BATCH ? command.instance_count - base : SF_POOL_CULL_BATCH;
+            const size_t from = command.base_instance + base;
+            const size_t inside = sf_frustum_cull(frustum, spheres + from, n, visible);
+            for (size_t i = 0; i < inside; ++i)
+                glm_mat4_copy(models[from + visible[i]], models[kept_models++]);
+        }
+        if (kept_models == first)
+            continue;
+        command.base_instance = (uint32_t)first;
+        command.instance_count = (uint32_t)(kept_models - first);
+        commands[kept_commands++] = command;
+    }
+    batch->commands.count = kept_commands;
+    batch->models.count = kept_models;
+}
+
+/// Copy data into a stream range, or into a fallback buffer that's orphaned first.
+/// Returns the buffer and offset the data ended up at.
+static sf_stream_range sf_pool_batch_upload(const GLenum target, GLuint buffer, size_t *capacity, const sf_vec *data) {
+    const size_t size = data->count * data->element_size;
+    sf_stream *stream = sf_stream_current();
+    sf_stream_range range;
+    if (stream && sf_stream_write(stream, data->data, size, sizeof(vec4), &range))
+        return range;
+
+    sf_gl_bind_buffer(target, buffer);
+    if (*capacity < data->count) {
+        *capacity = *capacity ? *capacity : SF_MESH_MIN_CAPACITY;
+        while (*capacity < data->count)
+            *capacity *= 2;
+    }
+    glBufferData(target, (GLsizeiptr)(*capacity * data->element_size), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, (GLsizeiptr)size, data->data);
+    return (sf_stream_range){buffer, 0, (GLsizeiptr)size};
+}
+
+sf_result sf_pool_batch_draw(sf_pool_batch *batch, sf_mesh_pool *pool, sf_shader *shader, sf_camera *camera, const sf_texture *texture) {
+    if (batch->commands.count == 0)
+        return sf_ok();
+
+    sf_camera_update(camera);
+    sf_pool_batch_cull(batch, &camera->frustum);
+    if (batch->commands.count == 0) {
+        sf_pool_batch_clear(batch);
+        return sf_ok();
+    }
+
+    sf_shader_bind(shader);
+    const sf_result res = sf_camera_bind(camera);
+    if (!res.ok) {
+        sf_pool_batch_clear(batch);
+        return res;
+    }
+
+    sf_gl_bind_framebuffer(camera->framebuffer);
+    sf_gl_active_texture(0);
+    sf_gl_bind_texture(texture->handle);
+    sf_gl_bind_vertex_array(pool->vao);
+
+    const sf_stream_range models = sf_pool_batch_upload(GL_ARRAY_BUFFER, pool->ibo, &pool->ibo_capacity, &batch->models);
+    const sf_draw_command *commands = batch->commands.data;
+
+    if (GLAD_GL_VERSION_4_3) {
+        // base_instance offsets the instance attributes, so they only need to point at the start of the models.
+        sf_instance_source(models.buffer, models.offset);
+        const sf_stream_range indirect = sf_pool_batch_upload(GL_DRAW_INDIRECT_BUFFER, batch->indirect, &batch->indirect_capacity, &batch->commands);
+        sf_gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, indirect.buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirect.offset, (GLsizei)batch->commands.count, 0);
+    } else {
+        // Instanced draws before 4.2 always start at instance 0, so the attributes are moved to each command's models instead.
+        for (size_t i = 0; i < batch->commands.count; ++i) {
+            const sf_draw_command *command = &commands[i];
+            sf_instance_source(models.buffer, models.offset + (GLintptr)(command->base_instance * sizeof(mat4)));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)command->count, GL_UNSIGNED_INT,
+                (void*)(command->first_index * sizeof(int32_t)), (GLsizei)command->instance_count, command->base_vertex);
+        }
+    }
+
+    sf_pool_batch_clear(batch);
+    return sf_ok();
+}
@@ -0,0 +1,157 @@
+#include "sf/queue.h"
+#include "sf/state.h"
+
+sf_render_queue sf_render_queue_new() {
+    return (sf_render_queue){
+        .items = sf_vec_new(sf_render_item),
+    };
+}
+
+void sf_render_queue_delete(sf_render_queue *queue) {
+    sf_vec_delete(&queue->items);
+    free(queue->keys);
+    free(queue->scratch);
+    free(queue->spheres);
+    free(queue->visible);
+    *queue = (sf_render_queue){};
+}
+
+/// Pack the state a draw needs into a key, most expensive state change in the highest bits.
+/// GL names are small integers in practice, so they're truncated to fit:
+/// framebuffer (12 bits) | program (16 bits) | texture (20 bits) | vertex array (16 bits)
+static uint64_t sf_render_key_make(const sf_render_item *item) {
+    return ((uint64_t)(item->camera->framebuffer & 0xFFFu) << 52)
+        | ((uint64_t)(item->shader->program & 0xFFFFu) << 36)
+        | ((uint64_t)(item->texture->handle & 0xFFFFFu) << 16)
+        | (uint64_t)(item->mesh->vao & 0xFFFFu);
+}
+
+void sf_render_queue_push(sf_render_queue *queue, sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const sf_transform transform, const sf_texture *texture) {
+    sf_render_item item = {
+        .mesh = mesh,
+        .shader = shader,
+        .camera = camera,
+        .texture = texture,
+    };
+    sf_transform_model(item.model, transform);
+    sf_vec_push(&queue->items, &item);
+}
+
+void sf_render_queue_push_matrix(sf_render_queue *queue, sf_mesh *mesh, sf_shader *shader, sf_camera *camera, const mat4 model, const sf_texture *texture) {
+    sf_render_item item = {
+        .mesh = mesh,
+        .shader = shader,
+        .camera = camera,
+        .texture = texture,
+    };
+    glm_mat4_copy((vec4 *)model, item.model);
+    sf_vec_push(&queue->items, &item);
+}
+
+void sf_render_queue_clear(sf_render_queue *queue) {
+    queue->items.count = 0;
+}
+
+/// Stable LSD radix sort over the keys, a byte per pass.
+/// Passes where every key has the same byte are skipped, which is most of them for typical scenes.
+/// Returns whichever buffer ends up holding the sorted keys.
+static sf_render_key *sf_render_sort(sf_render_key *keys, sf_render_key *scratch, const size_t count) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < count; ++i)
+            offsets[(keys[i].key >> shift) & 0xFF]++;
+        if (offsets[keys[0].key >> shift & 0xFF] == count)
+            continue;
+
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b) {
+            const size_t c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < count; ++i)
+            scratch[offsets[(keys[i].key >> shift) & 0xFF]++] = keys[i];
+
+        sf_render_key *tmp = keys;
+        keys = scratch;
+        scratch = tmp;
+    }
+    return keys;
+}
+
+sf_result sf_render_queue_flush(sf_render_queue *queue) {
+    const size_t count = queue->items.count;
+    if (count == 0)
+        return sf_ok();
+    const sf_render_item *items = queue->items.data;
+
+    if (count > queue->key_capacity) {
+        free(queue->keys);
+        free(queue->scratch);
+        free(queue->spheres);
+        free(queue->visible);
+        queue->key_capacity = count * 2;
+        queue->keys = sf_malloc(queue->key_capacity * sizeof(sf_render_key));
+        queue->scratch = sf_malloc(queue->key_capacity * sizeof(sf_render_key));
+        queue->spheres = sf_malloc(queue->key_capacity * sizeof(sf_sphere));
+        queue->visible = sf_malloc(queue->key_capacity * sizeof(uint32_t));
+    }
+
+    // Uploads bind buffers of their own, so get them all out of the way before submitting.
+    for (size_t i = 0; i < count; ++i) {
+        sf_mesh_update(items[i].mesh);
+        queue->spheres[i] = sf_sphere_transform(items[i].mesh->bounds.sphere, items[i].model);
+    }
+
+    // Cull every run of draws through the same camera as one batch, only what's left is sorted.
+    size_t kept = 0;
+    for (size_t first = 0, last; first < count; first = last) {
+        last = first + 1;
+        while (last < count && items[last].camera == items[first].camera)
+            last++;
+        sf_camera_update(items[first].camera);
+        const size_t inside = sf_frustum_cull(&items[first].camera->frustum, queue->spheres + first, last - first, queue->visible);
+        sf_occlusion *occlusion = queue->occlusion && queue->occlusion->camera == items[first].camera ? queue->occlusion : nullptr;
+        for (size_t i = 0; i < inside; ++i) {
+            const uint32_t index = (uint32_t)first + queue->visible[i];
+            if (occlusion && !sf_occlusion_test(occlusion, sf_aabb_transform(items[index].mesh->bounds.box, items[index].model)))
+                continue;
+            queue->keys[kept++] = (sf_render_key){sf_render_key_make(&items[index]), index};
+        }
+    }
+    sf_result res = sf_ok();
+    if (kept == 0)
+        goto cleanup;
+    const sf_render_key *sorted = sf_render_sort(queue->keys, queue->scratch, kept);
+
+    const sf_camera *camera = nullptr;
+
+    // Redundant binds between neighbouring draws are dropped by the state tracker.
+    sf_gl_active_texture(0);
+    for (size_t i = 0; i < kept; ++i) {
+        const sf_render_item *item = &items[sorted[i].index];
+
+        sf_gl_bind_framebuffer(item->camera->framebuffer);
+        sf_shader_bind(item->shader);
+        if (item->camera != camera) {
+            camera = item->camera;
+            res = sf_camera_bind(camera);
+            if (!res.ok)
+                goto cleanup;
+        }
+        sf_gl_bind_texture(item->texture->handle);
+        sf_gl_bind_vertex_array(item->mesh->vao);
+
+        if (item->shader->builtin.model == SF_UNIFORM_NONE) {
+            res = sf_err(sf_lit("Uniform 'm_model' not found."));
+            goto cleanup;
+        }
+        sf_shader_set_mat4(item->shader, item->shader->builtin.model, item->model);
+        sf_instance_identity();
+        glDrawElements(GL_TRIANGLES, (int32_t)item->mesh->indices.count, item->mesh->index_type, nullptr);
+    }
+
+cleanup:
+    sf_render_queue_clear(queue);
+    return res;
+}
@@ -1,26 +1,37 @@
+#include <stdio.h>
 #include <sf/numerics.h>
 #include <sf/fs.h>
 #include "sf/shaders.h"
 
-sf_result sf_load_shader(GLuint *out, const GLenum type, const sf_str path) {
-    sf_result res;
+/// Read a shader's source into a null terminated buffer the caller frees.
+static sf_result sf_read_shader(uint8_t **out, const GLenum type, const sf_str path) {
     const sf_str spath = sf_str_fmt("%s.%s", path.c_str, type == GL_FRAGMENT_SHADER ? "frag" : "vert");
-    uint8_t *sbuffer = nullptr;
-
-    *out = glCreateShader(type);
+    *out = nullptr;
 
+    sf_result res;
     const long s = sf_file_size(spath);
     if (s <= 0) {
         res = sf_err(sf_str_fmt("Failed to find vertex shader '%s'", spath.c_str));
         goto cleanup;
     }
 
-    sbuffer = sf_malloc((size_t)s + 1);
-    res = sf_load_file(sbuffer, spath);
-    if (!res.ok) goto cleanup;
-    sbuffer[s] = '\0';
+    *out = sf_malloc((size_t)s + 1);
+    res = sf_load_file(*out, spath);
+    if (!res.ok) {
+        free(*out);
+        *out = nullptr;
+        goto cleanup;
+    }
+    (*out)[s] = '\0';
 
-    glShaderSource(*out, 1, (const GLchar **)&sbuffer, nullptr);
+cleanup:
+    sf_str_free(spath);
+    return res;
+}
+
+sf_result sf_load_shader(GLuint *out, const GLenum type, const sf_str path, const uint8_t *source) {
+    *out = glCreateShader(type);
+    glShaderSource(*out, 1, (const GLchar **)&source, nullptr);
     glCompileShader(*out);
 
     int success;
@@ -28,30 +39,213 @@ sf_result sf_load_shader(GLuint *out, const GLenum type, const sf_str path) {
     if (!success) {
         char log[512];
         glGetShaderInfoLog(*out, 512, nullptr, log);
-        res = sf_err(sf_str_fmt("Failed to compile shader '%s': %s", spath.c_str, log));
+        return sf_err(sf_str_fmt("Failed to compile shader '%s.%s': %s", path.c_str, type == GL_FRAGMENT_SHADER ? "frag" : "vert", log));
+    }
+    return sf_ok();
+}
+
+/// Where program binaries are cached, cache_dir.c_str is null when caching is off.
+static sf_str sf_cache_dir = {};
+static sf_shader_cache_stats sf_cache_stats = {};
+
+#define SF_CACHE_MAGIC 0x42505346u // "SFPB"
+/// Header written in front of every cached program binary.
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+} sf_cache_header;
+
+void sf_shader_cache_enable(const sf_str directory) {
+    sf_shader_cache_disable();
+    sf_cache_dir = sf_str_dup(directory);
+}
+
+void sf_shader_cache_disable() {
+    if (sf_cache_dir.c_str)
+        sf_str_free(sf_cache_dir);
+    sf_cache_dir = (sf_str){};
+}
+
+sf_shader_cache_stats sf_shader_cache_get_stats() {
+    return sf_cache_stats;
+}
+
+/// Program binaries only exist from OpenGL 4.1, and drivers may still support no formats.
+static bool sf_cache_supported() {
+    if (!sf_cache_dir.c_str || !GLAD_GL_VERSION_4_1)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+static uint64_t sf_fnv1a(uint64_t hash, const char *data) {
+    // Include the terminator so "ab" + "c" and "a" + "bc" hash differently.
+    do {
+        hash ^= (uint8_t)*data;
+        hash *= 0x100000001B3ull;
+    } while (*data++);
+    return hash;
+}
+
+/// Key a program by its sources and the driver that would compile them.
+static uint64_t sf_cache_key(const uint8_t *vertex, const uint8_t *fragment) {
+    uint64_t key = 0xCBF29CE484222325ull;
+    key = sf_fnv1a(key, (const char *)vertex);
+    key = sf_fnv1a(key, (const char *)fragment);
+    key = sf_fnv1a(key, (const char *)glGetString(GL_VENDOR));
+    key = sf_fnv1a(key, (const char *)glGetString(GL_RENDERER));
+    key = sf_fnv1a(key, (const char *)glGetString(GL_VERSION));
+    return key;
+}
+
+static sf_str sf_cache_path(const uint64_t key) {
+    return sf_str_fmt("%s/%016llx.bin", sf_cache_dir.c_str, (unsigned long long)key);
+}
+
+/// Try to create a program from a cached binary, returns 0 if there's no usable binary.
+static GLuint sf_cache_load(const uint64_t key) {
+    const sf_str path = sf_cache_path(key);
+    GLuint program = 0;
+    uint8_t *buffer = nullptr;
+
+    const long size = sf_file_exists(path) ? sf_file_size(path) : 0;
+    if (size <= (long)sizeof(sf_cache_header))
+        goto cleanup;
+    buffer = sf_malloc((size_t)size);
+    if (!sf_load_file(buffer, path).ok)
+        goto cleanup;
+
+    sf_cache_header header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != SF_CACHE_MAGIC || header.key != key)
+        goto cleanup;
+
+    program = glCreateProgram();
+    glProgramBinary(program, header.format, buffer + sizeof(header), (GLsizei)((size_t)size - sizeof(header)));
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Driver updates and the like invalidate binaries, this one gets replaced after recompiling.
+        glDeleteProgram(program);
+        program = 0;
+        sf_cache_stats.rejected++;
     }
 
 cleanup:
-    sf_str_free(spath);
-    if (sbuffer) free(sbuffer);
-    return res;
+    if (buffer) free(buffer);
+    sf_str_free(path);
+    return program;
+}
+
+static void sf_cache_store(const uint64_t key, const GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    uint8_t *buffer = sf_malloc(sizeof(sf_cache_header) + (size_t)length);
+    sf_cache_header header = {.magic = SF_CACHE_MAGIC, .key = key};
+    glGetProgramBinary(program, length, nullptr, &header.format, buffer + sizeof(header));
+    memcpy(buffer, &header, sizeof(header));
+
+    const sf_str path = sf_cache_path(key);
+    FILE *file = fopen(path.c_str, "wb");
+    if (file) {
+        fwrite(buffer, 1, sizeof(header) + (size_t)length, file);
+        fclose(file);
+    }
+    sf_str_free(path);
+    free(buffer);
+}
+
+/// Find a uniform in a shader's table by name, SF_UNIFORM_NONE if it isn't active.
+static sf_uniform sf_shader_find(const sf_shader *shader, const char *name) {
+    for (size_t i = 0; i < shader->uniform_count; ++i)
+        if (strcmp(shader->uniforms[i].name.c_str, name) == 0)
+            return (sf_uniform)i;
+    return SF_UNIFORM_NONE;
+}
+
+/// Fill a linked shader's uniform table from the program's active uniforms.
+static void sf_shader_reflect(sf_shader *shader) {
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(shader->program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(shader->program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    shader->uniforms = count > 0 ? sf_calloc((size_t)count, sizeof(sf_uniform_info)) : nullptr;
+    shader->uniform_count = 0;
+    char *name = sf_malloc((size_t)max_length + 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(shader->program, (GLuint)i, max_length + 1, &length, &size, &type, name);
+
+        // Uniforms inside blocks have no location.
+        const GLint location = glGetUniformLocation(shader->program, name);
+        if (location < 0)
+            continue;
+        // Arrays are reported as "name[0]", make them reachable by their plain name.
+        if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+            name[length - 3] = '\0';
+
+        shader->uniforms[shader->uniform_count++] = (sf_uniform_info){
+            .name = sf_str_cdup(name),
+            .location = location,
+            .type = type,
+        };
+    }
+    free(name);
+
+    shader->builtin.model = sf_shader_find(shader, "m_model");
+    shader->builtin.sampler = sf_shader_find(shader, "t_sampler");
+
+    // Samplers keep their unit for the program's lifetime, so this only needs to be set once.
+    sf_gl_use_program(shader->program);
+    sf_shader_set_int(shader, shader->builtin.sampler, 0);
+
+    const GLuint camera_block = glGetUniformBlockIndex(shader->program, "sf_camera");
+    if (camera_block != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader->program, camera_block, SF_CAMERA_BINDING);
 }
 
 sf_result sf_shader_new(sf_shader *out, const sf_str path) {
     memset(out, 0, sizeof(sf_shader));
+    uint8_t *vsource = nullptr, *fsource = nullptr;
 
-    sf_result res = sf_load_shader(&out->vertex, GL_VERTEX_SHADER, path);
+    sf_result res = sf_read_shader(&vsource, GL_VERTEX_SHADER, path);
+    if (!res.ok)
+        goto result;
+    res = sf_read_shader(&fsource, GL_FRAGMENT_SHADER, path);
     if (!res.ok)
         goto result;
-    res = sf_load_shader(&out->fragment, GL_FRAGMENT_SHADER, path);
+
+    const bool cache = sf_cache_supported();
+    const uint64_t key = cache ? sf_cache_key(vsource, fsource) : 0;
+    if (cache && (out->program = sf_cache_load(key))) {
+        sf_cache_stats.hits++;
+        goto linked;
+    }
+
+    res = sf_load_shader(&out->vertex, GL_VERTEX_SHADER, path, vsource);
     if (!res.ok) {
         glDeleteShader(out->vertex);
         goto result;
     }
+    res = sf_load_shader(&out->fragment, GL_FRAGMENT_SHADER, path, fsource);
+    if (!res.ok) {
+        glDeleteShader(out->vertex);
+        glDeleteShader(out->fragment);
+        goto result;
+    }
 
     out->program = glCreateProgram();
     glAttachShader(out->program, out->vertex);
     glAttachShader(out->program, out->fragment);
+    if (cache)
+        glProgramParameteri(out->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(out->program);
 
     int success;
@@ -62,14 +256,21 @@ sf_result sf_shader_new(sf_shader *out, const sf_str path) {
 
         glDeleteShader(out->vertex);
         glDeleteShader(out->fragment);
-        res = sf_err(sf_str_fmt("Failed to link shader '%s': %s", path, log));
+        res = sf_err(sf_str_fmt("Failed to link shader '%s': %s", path.c_str, log));
         goto result;
     }
+    if (cache) {
+        sf_cache_stats.misses++;
+        sf_cache_store(key, out->program);
+    }
 
-    out->uniforms = sf_map_new();
+linked:
+    sf_shader_reflect(out);
     out->path = sf_str_dup(path);
 
 result:
+    if (vsource) free(vsource);
+    if (fsource) free(fsource);
     return res;
 }
 
@@ -79,103 +280,69 @@ void sf_shader_free(sf_shader *shader) {
     glDeleteShader(shader->vertex);
     glDeleteShader(shader->fragment);
 
+    sf_gl_forget_program(shader->program);
     glDeleteProgram(shader->program);
 
-    sf_map_delete(&shader->uniforms);
+    for (size_t i = 0; i < shader->uniform_count; ++i)
+        sf_str_free(shader->uniforms[i].name);
+    free(shader->uniforms);
+    shader->uniforms = nullptr;
+    shader->uniform_count = 0;
 }
 
-sf_result sf_get_uniform(sf_shader *shader, GLint *out, const sf_str name) {
-    if (sf_map_sexists(&shader->uniforms, name)) {
-        *out = sf_map_sget(&shader->uniforms, GLint, name);
-        return sf_ok();
-    }
-
-    const GLint loc = glGetUniformLocation(shader->program, name.c_str);
-    if (loc < 0)
+sf_result sf_shader_uniform(const sf_shader *shader, const sf_str name, sf_uniform *out) {
+    *out = sf_shader_find(shader, name.c_str);
+    if (*out == SF_UNIFORM_NONE)
         return sf_err(sf_str_fmt("Uniform '%s' not found.", name.c_str));
-    sf_map_sinsert(&shader->uniforms, name, &loc);
-    *out = loc;
-
     return sf_ok();
 }
 
 sf_result sf_shader_uniform_float(sf_shader *shader, const sf_str name, const float value) {
-    GLint uf;
-    const sf_result res = sf_get_uniform(shader, &uf, name);
+    sf_uniform uf;
+    const sf_result res = sf_shader_uniform(shader, name, &uf);
     if (!res.ok)
         return res;
-    glUniform1f(uf, value);
+    sf_shader_set_float(shader, uf, value);
 
     return sf_ok();
 }
 
 sf_result sf_shader_uniform_int(sf_shader *shader, const sf_str name, const int value) {
-    GLint uf;
-    const sf_result res = sf_get_uniform(shader, &uf, name);
+    sf_uniform uf;
+    const sf_result res = sf_shader_uniform(shader, name, &uf);
     if (!res.ok)
         return res;
-    glUniform1i(uf, value);
+    sf_shader_set_int(shader, uf, value);
 
     return sf_ok();
 }
 
 sf_result sf_shader_uniform_vec2(sf_shader *shader, const sf_str name, const sf_vec2 value) {
-    GLint uf;
-    const sf_result res = sf_get_uniform(shader, &uf, name);
+    sf_uniform uf;
+    const sf_result res = sf_shader_uniform(shader, name, &uf);
     if (!res.ok)
         return res;
-    glUniform2f(uf, value.x, value.y);
+    sf_shader_set_vec2(shader, uf, value);
 
     return sf_ok();
 }
 
 sf_result sf_shader_uniform_vec3(sf_shader *shader, const sf_str name, const sf_vec3 value) {
-    GLint uf;
-    const sf_result res = sf_get_uniform(shader, &uf, name);
+    sf_uniform uf;
+    const sf_result res = sf_shader_uniform(shader, name, &uf);
     if (!res.ok)
         return res;
-    glUniform3f(uf, value.x, value.y, value.z);
+    sf_shader_set_vec3(shader, uf, value);
 
     return sf_ok();
 }
 
 sf_result sf_shader_uniform_mat4(sf_shader *shader, const sf_str name, const mat4 value) {
-    GLint uf;
-    const sf_result res = sf_get_uniform(shader, &uf, name);
+    sf_uniform uf;
+    const sf_result res = sf_shader_uniform(shader, name, &uf);
     if (!res.ok)
         return res;
-    glUniformMatrix4fv(uf, 1, false, (const GLfloat *)value);
+    sf_shader_set_mat4(shader, uf, value);
 
     return sf_ok();
 }
-
-void sf_transform_model(mat4 out, const sf_transform transform) {
-    mat4 local;
-    glm_mat4_identity(local);
-    glm_scale(local, (vec3){transform.scale.x, transform.scale.y, transform.scale.z});
-
-    if (transform.parent) {
-        glm_translate(local, (vec3){transform.position.x, transform.position.y, transform.position.z});
-
-        glm_rotate(local, glm_rad(transform.rotation.x), (vec3){1, 0, 0});
-        glm_rotate(local, glm_rad(transform.rotation.y), (vec3){0, 1, 0});
-        glm_rotate(local, glm_rad(transform.rotation.z), (vec3){0, 0, 1});
-
-        mat4 parent_matrix;
-        sf_transform_model(parent_matrix, *transform.parent);
-        glm_mat4_mul(parent_matrix, local, out);
-    } else {
-        glm_rotate(local, glm_rad(transform.rotation.x), (vec3){1, 0, 0});
-        glm_rotate(local, glm_rad(transform.rotation.y), (vec3){0, 1, 0});
-        glm_rotate(local, glm_rad(transform.rotation.z), (vec3){0, 0, 1});
-
-        glm_translate(local, (vec3){transform.position.x, transform.position.y, transform.position.z});
-
-        glm_mat4_copy(local, out);
-    }
-}
-
-void sf_transform_view(mat4 out, const sf_transform transform) {
-    sf_transform_model(out, transform);
-    glm_mat4_inv(out, out);
-}
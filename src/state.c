@@ -0,0 +1,166 @@
+#include "sf/state.h"
+
+static sf_gl_state sf_gl_default_state = {};
+static sf_gl_state *sf_gl = &sf_gl_default_state;
+
+void sf_gl_state_make_current(sf_gl_state *state) {
+    sf_gl = state ? state : &sf_gl_default_state;
+}
+
+sf_gl_state *sf_gl_state_current() {
+    return sf_gl;
+}
+
+void sf_gl_state_invalidate() {
+    sf_gl->framebuffer = SF_GL_UNKNOWN;
+    sf_gl->program = SF_GL_UNKNOWN;
+    sf_gl->vertex_array = SF_GL_UNKNOWN;
+    for (int i = 0; i < SF_GL_BUFFER_TARGETS; ++i)
+        sf_gl->buffers[i] = SF_GL_UNKNOWN;
+    for (int i = 0; i < SF_GL_UNIFORM_BINDINGS; ++i)
+        sf_gl->uniform_buffers[i] = SF_GL_UNKNOWN;
+    sf_gl->active_texture = SF_GL_UNKNOWN;
+    for (int i = 0; i < SF_GL_TEXTURE_UNITS; ++i)
+        sf_gl->textures[i] = SF_GL_UNKNOWN;
+}
+
+void sf_gl_state_end_frame() {
+    sf_gl->last_frame = sf_gl->frame;
+    sf_gl->frame = (sf_gl_stats){0, 0};
+}
+
+sf_gl_stats sf_gl_frame_stats() {
+    return sf_gl->last_frame;
+}
+
+/// Update a tracked binding, returning whether the bind needs to be issued.
+static inline bool sf_gl_track(GLuint *slot, const GLuint name) {
+    if (*slot == name) {
+        sf_gl->frame.elided++;
+        return false;
+    }
+    *slot = name;
+    sf_gl->frame.issued++;
+    return true;
+}
+
+void sf_gl_bind_framebuffer(GLuint framebuffer) {
+    if (framebuffer == 0)
+        framebuffer = sf_gl->default_framebuffer;
+    if (sf_gl_track(&sf_gl->framebuffer, framebuffer))
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void sf_gl_use_program(const GLuint program) {
+    if (sf_gl_track(&sf_gl->program, program))
+        glUseProgram(program);
+}
+
+void sf_gl_bind_vertex_array(const GLuint vertex_array) {
+    if (sf_gl_track(&sf_gl->vertex_array, vertex_array)) {
+        glBindVertexArray(vertex_array);
+        // The element buffer binding belongs to the vertex array.
+        sf_gl->buffers[SF_GL_ELEMENT_ARRAY_BUFFER] = SF_GL_UNKNOWN;
+    }
+}
+
+static int sf_gl_buffer_slot(const GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return SF_GL_ARRAY_BUFFER;
+        case GL_ELEMENT_ARRAY_BUFFER: return SF_GL_ELEMENT_ARRAY_BUFFER;
+        case GL_UNIFORM_BUFFER: return SF_GL_UNIFORM_BUFFER;
+        case GL_COPY_READ_BUFFER: return SF_GL_COPY_READ_BUFFER;
+        case GL_COPY_WRITE_BUFFER: return SF_GL_COPY_WRITE_BUFFER;
+        case GL_PIXEL_UNPACK_BUFFER: return SF_GL_PIXEL_UNPACK_BUFFER;
+        default: return -1;
+    }
+}
+
+void sf_gl_bind_buffer(const GLenum target, const GLuint buffer) {
+    const int slot = sf_gl_buffer_slot(target);
+    if (slot < 0) {
+        sf_gl->frame.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (sf_gl_track(&sf_gl->buffers[slot], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void sf_gl_bind_buffer_base(const GLenum target, const GLuint index, const GLuint buffer) {
+    if (target != GL_UNIFORM_BUFFER || index >= SF_GL_UNIFORM_BINDINGS) {
+        sf_gl->frame.issued++;
+        glBindBufferBase(target, index, buffer);
+        const int slot = sf_gl_buffer_slot(target);
+        if (slot >= 0)
+            sf_gl->buffers[slot] = buffer;
+        return;
+    }
+    if (sf_gl_track(&sf_gl->uniform_buffers[index], buffer)) {
+        glBindBufferBase(target, index, buffer);
+        // Binding an indexed target also binds its generic target.
+        sf_gl->buffers[SF_GL_UNIFORM_BUFFER] = buffer;
+    }
+}
+
+void sf_gl_bind_buffer_range(const GLenum target, const GLuint index, const GLuint buffer, const GLintptr offset, const GLsizeiptr size) {
+    sf_gl->frame.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+    const int slot = sf_gl_buffer_slot(target);
+    if (slot >= 0)
+        sf_gl->buffers[slot] = buffer;
+    // The next whole-buffer bind can't be skipped, even if it's the same buffer.
+    if (target == GL_UNIFORM_BUFFER && index < SF_GL_UNIFORM_BINDINGS)
+        sf_gl->uniform_buffers[index] = SF_GL_UNKNOWN;
+}
+
+void sf_gl_active_texture(const GLuint unit) {
+    if (sf_gl_track(&sf_gl->active_texture, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void sf_gl_bind_texture(const GLuint texture) {
+    const GLuint unit = sf_gl->active_texture;
+    if (unit >= SF_GL_TEXTURE_UNITS) {
+        sf_gl->frame.issued++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+    if (sf_gl_track(&sf_gl->textures[unit], texture))
+        glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void sf_gl_forget_framebuffer(const GLuint framebuffer) {
+    if (sf_gl->framebuffer == framebuffer)
+        sf_gl->framebuffer = 0;
+    if (sf_gl->default_framebuffer == framebuffer)
+        sf_gl->default_framebuffer = 0;
+}
+
+void sf_gl_forget_program(const GLuint program) {
+    // A deleted program stays in use until something else is bound.
+    if (sf_gl->program == program)
+        sf_gl->program = SF_GL_UNKNOWN;
+}
+
+void sf_gl_forget_vertex_array(const GLuint vertex_array) {
+    if (sf_gl->vertex_array == vertex_array) {
+        sf_gl->vertex_array = 0;
+        sf_gl->buffers[SF_GL_ELEMENT_ARRAY_BUFFER] = SF_GL_UNKNOWN;
+    }
+}
+
+void sf_gl_forget_buffer(const GLuint buffer) {
+    for (int i = 0; i < SF_GL_BUFFER_TARGETS; ++i)
+        if (sf_gl->buffers[i] == buffer)
+            sf_gl->buffers[i] = 0;
+    for (int i = 0; i < SF_GL_UNIFORM_BINDINGS; ++i)
+        if (sf_gl->uniform_buffers[i] == buffer)
+            sf_gl->uniform_buffers[i] = 0;
+}
+
+void sf_gl_forget_texture(const GLuint texture) {
+    for (int i = 0; i < SF_GL_TEXTURE_UNITS; ++i)
+        if (sf_gl->textures[i] == texture)
+            sf_gl->textures[i] = 0;
+}
@@ -0,0 +1,166 @@
+#include "sf/stream.h"
+#include "sf/state.h"
+
+static sf_stream *sf_stream_active = nullptr;
+
+/// Create the stream's buffer for frame_size bytes per frame.
+static void sf_stream_allocate(sf_stream *stream, const size_t frame_size) {
+    stream->frame_size = frame_size;
+    glGenBuffers(1, &stream->buffer);
+    sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+
+    if (GLAD_GL_VERSION_4_4) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr size = (GLsizeiptr)(frame_size * SF_STREAM_FRAMES);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        stream->persistent = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        if (stream->persistent)
+            return;
+        // Mapping failed, use a plain buffer instead.
+        sf_gl_forget_buffer(stream->buffer);
+        glDeleteBuffers(1, &stream->buffer);
+        glGenBuffers(1, &stream->buffer);
+        sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    }
+    // Orphaned every frame, so a single region is enough.
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)frame_size, nullptr, GL_STREAM_DRAW);
+}
+
+static void sf_stream_release(sf_stream *stream) {
+    for (int i = 0; i < SF_STREAM_FRAMES; ++i) {
+        if (stream->fences[i])
+            glDeleteSync(stream->fences[i]);
+        stream->fences[i] = nullptr;
+    }
+    if (stream->buffer) {
+        sf_stream_unmap(stream);
+        if (stream->persistent) {
+            sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            stream->persistent = nullptr;
+        }
+        sf_gl_forget_buffer(stream->buffer);
+        glDeleteBuffers(1, &stream->buffer);
+        stream->buffer = 0;
+    }
+}
+
+sf_result sf_stream_new(sf_stream *out, const size_t frame_size) {
+    if (frame_size == 0)
+        return sf_err(sf_lit("A stream needs a frame size."));
+
+    *out = (sf_stream){};
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &out->uniform_alignment);
+    if (out->uniform_alignment < 1)
+        out->uniform_alignment = 256;
+    sf_stream_allocate(out, frame_size);
+    return sf_ok();
+}
+
+void sf_stream_delete(sf_stream *stream) {
+    sf_stream_release(stream);
+    if (sf_stream_active == stream)
+        sf_stream_active = nullptr;
+}
+
+void sf_stream_make_current(sf_stream *stream) {
+    sf_stream_active = stream;
+}
+
+sf_stream *sf_stream_current() {
+    return sf_stream_active;
+}
+
+void *sf_stream_map(sf_stream *stream, const size_t size, const size_t alignment, sf_stream_range *out) {
+    const size_t align = alignment ? alignment : 1;
+    const size_t offset = (stream->head + align - 1) / align * align;
+    if (offset + size > stream->frame_size) {
+        stream->missed += size + align - 1;
+        return nullptr;
+    }
+    stream->head = offset + size;
+
+    const size_t base = stream->persistent ? stream->frame * stream->frame_size : 0;
+    *out = (sf_stream_range){stream->buffer, (GLintptr)(base + offset), (GLsizeiptr)size};
+    if (stream->persistent)
+        return stream->persistent + base + offset;
+
+    // The buffer was orphaned when the frame started and ranges are never handed out twice,
+    // so nothing the gpu still reads can be overwritten.
+    sf_stream_unmap(stream);
+    sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    void *data = glMapBufferRange(GL_COPY_WRITE_BUFFER, out->offset, out->size,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    stream->mapped = data != nullptr;
+    return data;
+}
+
+void sf_stream_unmap(sf_stream *stream) {
+    if (!stream->mapped)
+        return;
+    sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    stream->mapped = false;
+}
+
+bool sf_stream_write(sf_stream *stream, const void *data, const size_t size, const size_t alignment, sf_stream_range *out) {
+    void *dst = sf_stream_map(stream, size, alignment, out);
+    if (!dst)
+        return false;
+    memcpy(dst, data, size);
+    sf_stream_unmap(stream);
+    return true;
+}
+
+bool sf_stream_copy(sf_stream *stream, const GLenum target, const GLintptr offset, const void *data, const size_t size) {
+    sf_stream_range range;
+    if (!sf_stream_write(stream, data, size, 4, &range))
+        return false;
+    sf_gl_bind_buffer(GL_COPY_READ_BUFFER, range.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, target, range.offset, offset, range.size);
+    return true;
+}
+
+void sf_stream_end_frame(sf_stream *stream) {
+    sf_stream_unmap(stream);
+
+    const size_t used = stream->head + stream->missed;
+    if (used > stream->peak)
+        stream->peak = used;
+
+    // The frame ran out of space, replace the buffer with one that fits.
+    // Everything streamed so far has been consumed by the time the fences are waited on.
+    if (stream->missed) {
+        size_t size = stream->frame_size;
+        while (size < used)
+            size *= 2;
+        for (int i = 0; i < SF_STREAM_FRAMES; ++i)
+            if (stream->fences[i])
+                glClientWaitSync(stream->fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        sf_stream_release(stream);
+        sf_stream_allocate(stream, size);
+        stream->head = stream->missed = 0;
+        stream->frame = 0;
+        return;
+    }
+
+    stream->head = 0;
+    if (!stream->persistent) {
+        sf_gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)stream->frame_size, nullptr, GL_STREAM_DRAW);
+        return;
+    }
+
+    stream->fences[stream->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->frame = (stream->frame + 1) % SF_STREAM_FRAMES;
+
+    GLsync fence = stream->fences[stream->frame];
+    if (!fence)
+        return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        stream->stalls++;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+    }
+    glDeleteSync(fence);
+    stream->fences[stream->frame] = nullptr;
+}
@@ -0,0 +1,76 @@
+#include <math.h>
+#include "sf/targets.h"
+
+/// Round one side up to the next eighth of a power of two, no smaller than SF_TARGET_MIN_SIZE.
+static float sf_target_bucket_side(const float side) {
+    uint32_t size = side > SF_TARGET_MIN_SIZE ? (uint32_t)ceilf(side) : SF_TARGET_MIN_SIZE;
+    uint32_t power = SF_TARGET_MIN_SIZE;
+    while (power * 2 <= size)
+        power *= 2;
+    const uint32_t step = power / 8;
+    size = (size + step - 1) / step * step;
+    return (float)size;
+}
+
+sf_vec2 sf_target_bucket(const sf_vec2 size) {
+    return (sf_vec2){sf_target_bucket_side(size.x), sf_target_bucket_side(size.y)};
+}
+
+sf_target_pool sf_target_pool_new() {
+    return (sf_target_pool){
+        .targets = sf_vec_new(sf_target),
+    };
+}
+
+void sf_target_pool_delete(sf_target_pool *pool) {
+    sf_target *targets = pool->targets.data;
+    for (size_t i = 0; i < pool->targets.count; ++i)
+        sf_texture_delete(&targets[i].texture);
+    sf_vec_delete(&pool->targets);
+    *pool = (sf_target_pool){};
+}
+
+sf_texture sf_target_acquire(sf_target_pool *pool, const sf_texture_type type, const sf_vec2 size) {
+    const sf_vec2 bucket = sf_target_bucket(size);
+    sf_target *targets = pool->targets.data;
+    for (size_t i = 0; i < pool->targets.count; ++i) {
+        sf_target *target = &targets[i];
+        if (!target->used && target->texture.type == type
+            && target->texture.dimensions.x == bucket.x && target->texture.dimensions.y == bucket.y) {
+            target->used = true;
+            return target->texture;
+        }
+    }
+
+    // Depth is only ever attached, color is usually sampled by a later pass.
+    const sf_texture_usage usage = SF_TEXTURE_RENDER_TARGET | (type == SF_TEXTURE_DEPTH_STENCIL ? 0 : SF_TEXTURE_SAMPLED);
+    const sf_target target = {
+        .texture = sf_texture_new(type, bucket, usage),
+        .used = true,
+    };
+    sf_vec_push(&pool->targets, &target);
+    return target.texture;
+}
+
+void sf_target_release(sf_target_pool *pool, const sf_texture *texture) {
+    sf_target *targets = pool->targets.data;
+    for (size_t i = 0; i < pool->targets.count; ++i)
+        if (targets[i].texture.handle == texture->handle) {
+            targets[i].used = false;
+            targets[i].released = pool->frame;
+            return;
+        }
+}
+
+void sf_target_pool_end_frame(sf_target_pool *pool) {
+    sf_target *targets = pool->targets.data;
+    for (size_t i = 0; i < pool->targets.count;) {
+        if (!targets[i].used && pool->frame - targets[i].released >= SF_TARGET_KEEP_FRAMES) {
+            sf_texture_delete(&targets[i].texture);
+            targets[i] = targets[--pool->targets.count];
+            continue;
+        }
+        i++;
+    }
+    pool->frame++;
+}
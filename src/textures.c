@@ -1,23 +1,83 @@
+#include <limits.h>
 #include <sf/fs.h>
 #include "sf/textures.h"
+#include "sf/state.h"
 #include "stb/stb_image.h"
 
-sf_texture sf_texture_new(sf_texture_type type, const sf_vec2 dimensions) {
-    sf_texture tex = {
-        .type = type,
-    };
+/// The sized internal format of a texture type, and the format and type its pixels are uploaded as.
+static void sf_texture_formats(const sf_texture_type type, GLenum *internal_format, GLenum *format, GLenum *g_type) {
+    switch (type) {
+        case SF_TEXTURE_RGB:
+            *internal_format = GL_RGB8;
+            *format = GL_RGB;
+            *g_type = GL_UNSIGNED_BYTE;
+            break;
+        case SF_TEXTURE_DEPTH_STENCIL:
+            *internal_format = GL_DEPTH24_STENCIL8;
+            *format = GL_DEPTH_STENCIL;
+            *g_type = GL_UNSIGNED_INT_24_8;
+            break;
+        default:
+            *internal_format = GL_RGBA8;
+            *format = GL_RGBA;
+            *g_type = GL_UNSIGNED_BYTE;
+            break;
+    }
+}
+
+uint8_t sf_texture_levels(const sf_vec2 dimensions, const sf_texture_usage usage) {
+    if ((usage & SF_TEXTURE_MIPMAPPED) == 0 || (usage & SF_TEXTURE_RENDER_TARGET) != 0)
+        return 1;
+    uint32_t size = (uint32_t)(dimensions.x > dimensions.y ? dimensions.x : dimensions.y);
+    uint8_t levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
 
-    glGenTextures(1, &tex.handle);
-    glBindTexture(GL_TEXTURE_2D, tex.handle);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+/// Generate a texture object and allocate its storage, immutable when OpenGL 4.2 is available.
+static void sf_texture_allocate(sf_texture *texture, const sf_vec2 dimensions) {
+    texture->dimensions = dimensions;
+    texture->levels = sf_texture_levels(dimensions, texture->usage);
+    texture->mips_dirty = false;
+
+    glGenTextures(1, &texture->handle);
+    sf_gl_bind_texture(texture->handle);
+    const GLint wrap = (texture->usage & SF_TEXTURE_RENDER_TARGET) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture->levels > 1 ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    sf_texture_resize(&tex, dimensions);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levels - 1);
 
+    GLenum internal_format, format, g_type;
+    sf_texture_formats(texture->type, &internal_format, &format, &g_type);
+    if (GLAD_GL_VERSION_4_2)
+        glTexStorage2D(GL_TEXTURE_2D, texture->levels, internal_format, (int)dimensions.x, (int)dimensions.y);
+    // Only level 0 is allocated up front, glGenerateMipmap allocates the rest once there are contents.
+    else glTexImage2D(GL_TEXTURE_2D, 0, (GLint)internal_format, (int)dimensions.x,
+        (int)dimensions.y, 0, format, g_type, nullptr);
+}
+
+sf_texture sf_texture_new(const sf_texture_type type, const sf_vec2 dimensions, const sf_texture_usage usage) {
+    sf_texture tex = {
+        .type = type,
+        .usage = usage,
+    };
+    sf_texture_allocate(&tex, dimensions);
     return tex;
 }
 
+/// Upload a decoded RGBA image into a new mipmapped texture, and free it.
+static void sf_texture_upload(sf_texture *out, uint8_t *pixels, const int width, const int height) {
+    *out = sf_texture_new(SF_TEXTURE_RGBA, (sf_vec2){(float)width, (float)height}, SF_TEXTURE_SAMPLED | SF_TEXTURE_MIPMAPPED);
+    sf_texture_write(out, pixels);
+    sf_texture_update(out);
+    stbi_image_free(pixels);
+}
+
 sf_result sf_texture_load(sf_texture *out, const sf_str path) {
     *out = (sf_texture){};
 
@@ -29,53 +89,81 @@ sf_result sf_texture_load(sf_texture *out, const sf_str path) {
     uint8_t *buffer = stbi_load(path.c_str, &width, &height, &channels, 4 /* RGBA */);
     if (!buffer)
         return sf_err(sf_str_fmt("File '%s' could not be loaded.", path.c_str));
-    out->dimensions = (sf_vec2){(float)width, (float)height};
-
-    glGenTextures(1, &out->handle);
-    glBindTexture(GL_TEXTURE_2D, out->handle);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    sf_texture_upload(out, buffer, width, height);
+    return sf_ok();
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (int)out->dimensions.x,
-    (int)out->dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
+sf_result sf_texture_load_memory(sf_texture *out, const uint8_t *data, const size_t size) {
+    *out = (sf_texture){};
+    if (size > INT_MAX)
+        return sf_err(sf_lit("Image is too large to decode."));
 
+    stbi_set_flip_vertically_on_load(1);
+    int width, height, channels;
+    uint8_t *buffer = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 4 /* RGBA */);
+    if (!buffer)
+        return sf_err(sf_str_fmt("Image could not be decoded: %s.", stbi_failure_reason()));
+    sf_texture_upload(out, buffer, width, height);
     return sf_ok();
 }
 
-EXPORT void sf_texture_resize(sf_texture *texture, const sf_vec2 dimensions) {
+void sf_texture_write(sf_texture *texture, const void *pixels) {
+    GLenum internal_format, format, g_type;
+    sf_texture_formats(texture->type, &internal_format, &format, &g_type);
+    sf_gl_bind_texture(texture->handle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (int)texture->dimensions.x, (int)texture->dimensions.y, format, g_type, pixels);
+    sf_texture_touch(texture);
+}
+
+void sf_texture_touch(sf_texture *texture) {
+    texture->mips_dirty = texture->levels > 1;
+}
+
+void sf_texture_update(sf_texture *texture) {
+    if (!texture->mips_dirty)
+        return;
+    sf_gl_bind_texture(texture->handle);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    texture->mips_dirty = false;
+}
+
+void sf_texture_resize(sf_texture *texture, const sf_vec2 dimensions) {
     if (dimensions.x == texture->dimensions.x && dimensions.y == texture->dimensions.y)
         return;
 
-    glBindTexture(GL_TEXTURE_2D, texture->handle);
-    GLint internal_format = GL_RGBA;
-    GLuint format = GL_RGBA;
-    GLuint g_type = GL_UNSIGNED_BYTE;
-    switch (texture->type) {
-        case SF_TEXTURE_RGB:
-            internal_format = GL_RGB;
-            format = GL_RGB;
-            g_type = GL_UNSIGNED_BYTE;
-            break;
-        case SF_TEXTURE_DEPTH_STENCIL:
-            internal_format = GL_DEPTH24_STENCIL8;
-            format = GL_DEPTH_STENCIL;
-            g_type = GL_UNSIGNED_INT_24_8;
-            break;
-        default: break;
+    if (GLAD_GL_VERSION_4_2) {
+        sf_texture_delete(texture);
+        sf_texture_allocate(texture, dimensions);
+        return;
     }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, (int)dimensions.x,
-        (int)dimensions.y, 0, format, g_type, nullptr);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
     texture->dimensions = dimensions;
+    texture->levels = sf_texture_levels(dimensions, texture->usage);
+    texture->mips_dirty = false;
+    GLenum internal_format, format, g_type;
+    sf_texture_formats(texture->type, &internal_format, &format, &g_type);
+    sf_gl_bind_texture(texture->handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levels - 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)internal_format, (int)dimensions.x,
+        (int)dimensions.y, 0, format, g_type, nullptr);
+}
+
+size_t sf_texture_bytes(const sf_texture *texture) {
+    // Drivers pad RGB8 out to four bytes a pixel, the same as RGBA8 and packed depth/stencil.
+    size_t width = (size_t)texture->dimensions.x, height = (size_t)texture->dimensions.y;
+    size_t bytes = 0;
+    for (uint8_t level = 0; level < texture->levels; ++level) {
+        bytes += width * height * 4;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes;
 }
 
 void sf_texture_delete(sf_texture *texture) {
+    sf_gl_forget_texture(texture->handle);
     glDeleteTextures(1, &texture->handle);
+    texture->handle = 0;
     texture->dimensions = (sf_vec2){0, 0};
 }
@@ -0,0 +1,184 @@
+#include "sf/transforms.h"
+#include "util.h"
+
+void sf_transform_local(mat4 out, const sf_transform transform, const bool has_parent) {
+    glm_mat4_identity(out);
+    glm_scale(out, (vec3){transform.scale.x, transform.scale.y, transform.scale.z});
+
+    if (has_parent)
+        glm_translate(out, (vec3){transform.position.x, transform.position.y, transform.position.z});
+
+    glm_rotate(out, glm_rad(transform.rotation.x), (vec3){1, 0, 0});
+    glm_rotate(out, glm_rad(transform.rotation.y), (vec3){0, 1, 0});
+    glm_rotate(out, glm_rad(transform.rotation.z), (vec3){0, 0, 1});
+
+    if (!has_parent)
+        glm_translate(out, (vec3){transform.position.x, transform.position.y, transform.position.z});
+}
+
+void sf_transform_model(mat4 out, const sf_transform transform) {
+    if (transform.parent) {
+        mat4 local, parent_matrix;
+        sf_transform_local(local, transform, true);
+        sf_transform_model(parent_matrix, *transform.parent);
+        glm_mat4_mul(parent_matrix, local, out);
+    } else
+        sf_transform_local(out, transform, false);
+}
+
+void sf_transform_view(mat4 out, const sf_transform transform) {
+    sf_transform_model(out, transform);
+    glm_mat4_inv(out, out);
+}
+
+sf_transform_tree sf_transform_tree_new() {
+    return (sf_transform_tree){};
+}
+
+void sf_transform_tree_delete(sf_transform_tree *tree) {
+    free(tree->position);
+    free(tree->rotation);
+    free(tree->scale);
+    free(tree->parent);
+    free(tree->world);
+    free(tree->dirty);
+    *tree = (sf_transform_tree){};
+}
+
+sf_transform_node sf_transform_tree_add(sf_transform_tree *tree, const sf_transform local, const sf_transform_node parent) {
+    if (parent != SF_TRANSFORM_NONE && (parent < 0 || (size_t)parent >= tree->count))
+        return SF_TRANSFORM_NONE;
+    if (tree->count == tree->capacity) {
+        tree->capacity = tree->capacity ? tree->capacity * 2 : 64;
+        tree->position = sf_grow(tree->position, tree->capacity * sizeof(sf_vec3));
+        tree->rotation = sf_grow(tree->rotation, tree->capacity * sizeof(sf_vec3));
+        tree->scale = sf_grow(tree->scale, tree->capacity * sizeof(sf_vec3));
+        tree->parent = sf_grow(tree->parent, tree->capacity * sizeof(sf_transform_node));
+        tree->world = sf_grow(tree->world, tree->capacity * sizeof(mat4));
+        tree->dirty = sf_grow(tree->dirty, tree->capacity * sizeof(bool));
+    }
+
+    const size_t node = tree->count++;
+    tree->position[node] = local.position;
+    tree->rotation[node] = local.rotation;
+    tree->scale[node] = local.scale;
+    tree->parent[node] = parent;
+    tree->dirty[node] = true;
+    glm_mat4_identity(tree->world[node]);
+    return (sf_transform_node)node;
+}
+
+void sf_transform_tree_set(sf_transform_tree *tree, const sf_transform_node node, const sf_transform local) {
+    tree->position[node] = local.position;
+    tree->rotation[node] = local.rotation;
+    tree->scale[node] = local.scale;
+    tree->dirty[node] = true;
+}
+
+sf_transform sf_transform_tree_get(const sf_transform_tree *tree, const sf_transform_node node) {
+    return (sf_transform){
+        .position = tree->position[node],
+        .rotation = tree->rotation[node],
+        .scale = tree->scale[node],
+    };
+}
+
+void sf_transform_tree_update(sf_transform_tree *tree) {
+    // Parents come before children, so a parent's dirty flag is final by the time its children see it.
+    for (size_t i = 0; i < tree->count; ++i) {
+        const sf_transform_node parent = tree->parent[i];
+        if (parent >= 0 && tree->dirty[parent])
+            tree->dirty[i] = true;
+        if (!tree->dirty[i])
+            continue;
+
+        const sf_transform local = {
+            .position = tree->position[i],
+            .rotation = tree->rotation[i],
+            .scale = tree->scale[i],
+        };
+        if (parent >= 0) {
+            mat4 matrix;
+            sf_transform_local(matrix, local, true);
+            glm_mat4_mul(tree->world[parent], matrix, tree->world[i]);
+        } else
+            sf_transform_local(tree->world[i], local, false);
+    }
+    if (tree->count)
+        memset(tree->dirty, 0, tree->count * sizeof(bool));
+}
+
+// Batched transform kernel.
+// Each block converts SF_TRANSFORM_LANES transforms at once, one transform per SIMD lane,
+// then transposes the lanes back into column-major matrices.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SF_TRANSFORM_LANES 4
+#define sf_lanes __m128
+#define sf_lanes_load(p) _mm_loadu_ps(p)
+#define sf_lanes_set(x) _mm_set1_ps(x)
+#define sf_lanes_add(a, b) _mm_add_ps(a, b)
+#define sf_lanes_sub(a, b) _mm_sub_ps(a, b)
+#define sf_lanes_mul(a, b) _mm_mul_ps(a, b)
+#define sf_lanes_select(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+#else
+#define SF_TRANSFORM_LANES 1
+#define sf_lanes float
+#define sf_lanes_load(p) (*(p))
+#define sf_lanes_set(x) (x)
+#define sf_lanes_add(a, b) ((a) + (b))
+#define sf_lanes_sub(a, b) ((a) - (b))
+#define sf_lanes_mul(a, b) ((a) * (b))
+static inline float sf_lanes_select(const float mask, const float a, const float b) {
+    uint32_t bits;
+    memcpy(&bits, &mask, sizeof(bits));
+    return bits ? a : b;
+}
+#endif
+#define SF_KERNEL_TARGET
+#define SF_KERNEL(name) name
+#include "transforms_kernel.h"
+
+#if SF_AVX2
+#include <immintrin.h>
+#undef SF_TRANSFORM_LANES
+#undef sf_lanes
+#undef sf_lanes_load
+#undef sf_lanes_set
+#undef sf_lanes_add
+#undef sf_lanes_sub
+#undef sf_lanes_mul
+#undef sf_lanes_select
+#undef SF_KERNEL_TARGET
+#undef SF_KERNEL
+#define SF_TRANSFORM_LANES 8
+#define sf_lanes __m256
+#define sf_lanes_load(p) _mm256_loadu_ps(p)
+#define sf_lanes_set(x) _mm256_set1_ps(x)
+#define sf_lanes_add(a, b) _mm256_add_ps(a, b)
+#define sf_lanes_sub(a, b) _mm256_sub_ps(a, b)
+#define sf_lanes_mul(a, b) _mm256_mul_ps(a, b)
+#define sf_lanes_select(mask, a, b) _mm256_blendv_ps(b, a, mask)
+#define SF_KERNEL_TARGET SF_TARGET_AVX2
+#define SF_KERNEL(name) name##_avx2
+#include "transforms_kernel.h"
+#endif
+
+void sf_transform_models(mat4 *out, const sf_transform *transforms, const size_t count) {
+#if SF_AVX2
+    if (sf_cpu_avx2())
+        sf_transform_blocks_avx2(out, transforms, count);
+    else
+#endif
+    sf_transform_blocks(out, transforms, count);
+
+    // Parent chains are rare in large batches, resolve them with the scalar path.
+    for (size_t i = 0; i < count; ++i) {
+        if (!transforms[i].parent)
+            continue;
+        mat4 parent, local;
+        sf_transform_model(parent, *transforms[i].parent);
+        glm_mat4_copy(out[i], local);
+        glm_mat4_mul(parent, local, out[i]);
+    }
+}
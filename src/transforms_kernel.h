@@ -0,0 +1,103 @@
+// The batched transform kernel, included by transforms.c once for every instruction set it's built for.
+// Expects SF_TRANSFORM_LANES, sf_lanes and its operations, SF_KERNEL_TARGET for the functions' target attribute,
+// and SF_KERNEL(name) to give the functions a name of their own.
+
+/// Transpose the lanes back into n matrices, cols[c][r] holds row r of column c for every lane.
+SF_KERNEL_TARGET static inline void SF_KERNEL(sf_transform_store)(mat4 *out, const size_t n, sf_lanes cols[4][4]) {
+#if SF_TRANSFORM_LANES == 8
+    for (int c = 0; c < 4; ++c) {
+        __m128 lo[4], hi[4];
+        for (int r = 0; r < 4; ++r) {
+            lo[r] = _mm256_castps256_ps128(cols[c][r]);
+            hi[r] = _mm256_extractf128_ps(cols[c][r], 1);
+        }
+        _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+        _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+        for (size_t k = 0; k < n; ++k)
+            _mm_storeu_ps(out[k][c], k < 4 ? lo[k] : hi[k - 4]);
+    }
+#elif SF_TRANSFORM_LANES == 4
+    for (int c = 0; c < 4; ++c) {
+        __m128 r0 = cols[c][0], r1 = cols[c][1], r2 = cols[c][2], r3 = cols[c][3];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        const __m128 lanes[4] = {r0, r1, r2, r3};
+        for (size_t k = 0; k < n; ++k)
+            _mm_storeu_ps(out[k][c], lanes[k]);
+    }
+#else
+    (void)n;
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            out[0][c][r] = cols[c][r];
+#endif
+}
+
+/// Convert up to SF_TRANSFORM_LANES transforms into local matrices.
+/// The rotation is built directly from the sines and cosines of the three angles,
+/// equal to the three glm_rotate calls in sf_transform_local.
+SF_KERNEL_TARGET static void SF_KERNEL(sf_transform_block)(mat4 *out, const sf_transform *transforms, const size_t n) {
+    float px[SF_TRANSFORM_LANES], py[SF_TRANSFORM_LANES], pz[SF_TRANSFORM_LANES];
+    float sx[SF_TRANSFORM_LANES], sy[SF_TRANSFORM_LANES], sz[SF_TRANSFORM_LANES];
+    float sa[SF_TRANSFORM_LANES], ca[SF_TRANSFORM_LANES], sb[SF_TRANSFORM_LANES];
+    float cb[SF_TRANSFORM_LANES], sc[SF_TRANSFORM_LANES], cc[SF_TRANSFORM_LANES];
+    float child[SF_TRANSFORM_LANES];
+
+    for (size_t k = 0; k < SF_TRANSFORM_LANES; ++k) {
+        // Unused lanes get an identity transform.
+        const sf_transform t = k < n ? transforms[k] : (sf_transform){.scale = {1, 1, 1}};
+        px[k] = t.position.x; py[k] = t.position.y; pz[k] = t.position.z;
+        sx[k] = t.scale.x; sy[k] = t.scale.y; sz[k] = t.scale.z;
+        const float a = glm_rad(t.rotation.x), b = glm_rad(t.rotation.y), c = glm_rad(t.rotation.z);
+        sa[k] = sinf(a); ca[k] = cosf(a);
+        sb[k] = sinf(b); cb[k] = cosf(b);
+        sc[k] = sinf(c); cc[k] = cosf(c);
+        const uint32_t mask = t.parent ? UINT32_MAX : 0;
+        memcpy(&child[k], &mask, sizeof(float));
+    }
+
+    const sf_lanes vsa = sf_lanes_load(sa), vca = sf_lanes_load(ca);
+    const sf_lanes vsb = sf_lanes_load(sb), vcb = sf_lanes_load(cb);
+    const sf_lanes vsc = sf_lanes_load(sc), vcc = sf_lanes_load(cc);
+    const sf_lanes vsx = sf_lanes_load(sx), vsy = sf_lanes_load(sy), vsz = sf_lanes_load(sz);
+    const sf_lanes vpx = sf_lanes_load(px), vpy = sf_lanes_load(py), vpz = sf_lanes_load(pz);
+
+    // R = Rx(a) * Ry(b) * Rz(c), rRC is row R column C.
+    const sf_lanes sasb = sf_lanes_mul(vsa, vsb), casb = sf_lanes_mul(vca, vsb);
+    const sf_lanes r00 = sf_lanes_mul(vcb, vcc);
+    const sf_lanes r01 = sf_lanes_sub(sf_lanes_set(0.0f), sf_lanes_mul(vcb, vsc));
+    const sf_lanes r02 = vsb;
+    const sf_lanes r10 = sf_lanes_add(sf_lanes_mul(sasb, vcc), sf_lanes_mul(vca, vsc));
+    const sf_lanes r11 = sf_lanes_sub(sf_lanes_mul(vca, vcc), sf_lanes_mul(sasb, vsc));
+    const sf_lanes r12 = sf_lanes_sub(sf_lanes_set(0.0f), sf_lanes_mul(vsa, vcb));
+    const sf_lanes r20 = sf_lanes_sub(sf_lanes_mul(vsa, vsc), sf_lanes_mul(casb, vcc));
+    const sf_lanes r21 = sf_lanes_add(sf_lanes_mul(casb, vsc), sf_lanes_mul(vsa, vcc));
+    const sf_lanes r22 = sf_lanes_mul(vca, vcb);
+
+    // Without a parent the translation is applied last (S * R * T), so it's rotated.
+    // With one it's applied before rotating (S * T * R).
+    const sf_lanes vchild = sf_lanes_load(child);
+    const sf_lanes t0 = sf_lanes_select(vchild, vpx,
+        sf_lanes_add(sf_lanes_add(sf_lanes_mul(r00, vpx), sf_lanes_mul(r01, vpy)), sf_lanes_mul(r02, vpz)));
+    const sf_lanes t1 = sf_lanes_select(vchild, vpy,
+        sf_lanes_add(sf_lanes_add(sf_lanes_mul(r10, vpx), sf_lanes_mul(r11, vpy)), sf_lanes_mul(r12, vpz)));
+    const sf_lanes t2 = sf_lanes_select(vchild, vpz,
+        sf_lanes_add(sf_lanes_add(sf_lanes_mul(r20, vpx), sf_lanes_mul(r21, vpy)), sf_lanes_mul(r22, vpz)));
+
+    const sf_lanes zero = sf_lanes_set(0.0f), one = sf_lanes_set(1.0f);
+    sf_lanes cols[4][4] = {
+        {sf_lanes_mul(vsx, r00), sf_lanes_mul(vsy, r10), sf_lanes_mul(vsz, r20), zero},
+        {sf_lanes_mul(vsx, r01), sf_lanes_mul(vsy, r11), sf_lanes_mul(vsz, r21), zero},
+        {sf_lanes_mul(vsx, r02), sf_lanes_mul(vsy, r12), sf_lanes_mul(vsz, r22), zero},
+        {sf_lanes_mul(vsx, t0), sf_lanes_mul(vsy, t1), sf_lanes_mul(vsz, t2), one},
+    };
+    SF_KERNEL(sf_transform_store)(out, n, cols);
+}
+
+
+/// Convert count transforms into local matrices, a block at a time.
+SF_KERNEL_TARGET static void SF_KERNEL(sf_transform_blocks)(mat4 *out, const sf_transform *transforms, const size_t count) {
+    for (size_t i = 0; i < count; i += SF_TRANSFORM_LANES) {
+        const size_t n = count - i < SF_TRANSFORM_LANES ? count - i : SF_TRANSFORM_LANES;
+        SF_KERNEL(sf_transform_block)(out + i, transforms + i, n);
+    }
+}
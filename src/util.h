@@ -0,0 +1,28 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+// Helpers shared between the library's sources, not part of its interface.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/// Resize an array of the library's own, aborting if there's no memory left like sf_malloc.
+static inline void *sf_grow(void *array, const size_t size) {
+    void *grown = realloc(array, size);
+    if (!grown)
+        abort();
+    return grown;
+}
+
+// AVX2 kernels are compiled with a target attribute rather than -mavx2, so no file is built with __AVX__,
+// which would make cglm align mat4 to 32 bytes inside the library but not in the programs using it.
+// They're picked at runtime on cpus that support them.
+#if defined(SF_ENABLE_AVX2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#    define SF_AVX2 1
+#    define SF_TARGET_AVX2 __attribute__((target("avx2")))
+static inline bool sf_cpu_avx2() { return __builtin_cpu_supports("avx2"); }
+#else
+#    define SF_AVX2 0
+#endif
+
+#endif // UTIL_H
@@ -0,0 +1,131 @@
+#include "sf/vertices.h"
+
+#include <math.h>
+#include "sf/state.h"
+#include "sf/stream.h"
+
+/// Where each attribute starts in an sf_vertex, in floats, and how many components it has.
+static const uint8_t sf_attribute_first[SF_ATTRIBUTE_COUNT] = { 0, 3, 5 };
+static const uint8_t sf_attribute_components[SF_ATTRIBUTE_COUNT] = { 3, 2, 4 };
+
+static size_t sf_format_size(const sf_vertex_format format) {
+    switch (format) {
+        case SF_FORMAT_FLOAT: return 4;
+        case SF_FORMAT_HALF: case SF_FORMAT_UNORM16: case SF_FORMAT_SNORM16: return 2;
+        case SF_FORMAT_UNORM8: return 1;
+        default: return 0;
+    }
+}
+
+sf_vertex_layout sf_vertex_layout_new(const sf_vertex_format position, const sf_vertex_format uv, const sf_vertex_format color) {
+    sf_vertex_layout layout = { .formats = { position, uv, color } };
+    size_t offset = 0;
+    for (int a = 0; a < SF_ATTRIBUTE_COUNT; ++a) {
+        layout.offsets[a] = (uint8_t)offset;
+        offset += (sf_format_size(layout.formats[a]) * sf_attribute_components[a] + 3) & ~(size_t)3;
+    }
+    layout.stride = (uint8_t)offset;
+    return layout;
+}
+
+/// Whether vertices can be copied to vram as they are.
+static bool sf_vertex_layout_native(const sf_vertex_layout *layout) {
+    return layout->formats[SF_ATTRIBUTE_POSITION] == SF_FORMAT_FLOAT
+        && layout->formats[SF_ATTRIBUTE_UV] == SF_FORMAT_FLOAT
+        && layout->formats[SF_ATTRIBUTE_COLOR] == SF_FORMAT_FLOAT;
+}
+
+static inline float sf_clamp(const float value, const float min, const float max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+void sf_vertex_pack(const sf_vertex_layout *layout, void *out, const sf_vertex *vertices, const size_t count) {
+    if (sf_vertex_layout_native(layout)) {
+        memcpy(out, vertices, count * sizeof(sf_vertex));
+        return;
+    }
+
+    uint8_t *dst = out;
+    memset(dst, 0, count * layout->stride);
+    for (size_t i = 0; i < count; ++i, dst += layout->stride) {
+        float v[9];
+        memcpy(v, &vertices[i], sizeof(v));
+        for (int a = 0; a < SF_ATTRIBUTE_COUNT; ++a) {
+            const float *src = v + sf_attribute_first[a];
+            uint8_t *attr = dst + layout->offsets[a];
+            for (int c = 0; c < sf_attribute_components[a]; ++c) {
+                switch (layout->formats[a]) {
+                    case SF_FORMAT_FLOAT:
+                        memcpy(attr + c * 4, &src[c], 4);
+                        break;
+                    case SF_FORMAT_HALF: {
+                        const uint16_t h = sf_float_to_half(src[c]);
+                        memcpy(attr + c * 2, &h, 2);
+                        break;
+                    }
+                    case SF_FORMAT_UNORM8:
+                        attr[c] = (uint8_t)lrintf(sf_clamp(src[c], 0, 1) * 255.0f);
+                        break;
+                    case SF_FORMAT_UNORM16: {
+                        const uint16_t u = (uint16_t)lrintf(sf_clamp(src[c], 0, 1) * 65535.0f);
+                        memcpy(attr + c * 2, &u, 2);
+                        break;
+                    }
+                    case SF_FORMAT_SNORM16: {
+                        const int16_t s = (int16_t)lrintf(sf_clamp(src[c], -1, 1) * 32767.0f);
+                        memcpy(attr + c * 2, &s, 2);
+                        break;
+                    }
+                    default: break;
+                }
+            }
+        }
+    }
+}
+
+void sf_vertex_upload(const sf_vertex_layout *layout, const GLenum target, const GLintptr offset, const sf_vertex *vertices, const size_t count) {
+    if (count == 0)
+        return;
+    const size_t size = count * layout->stride;
+
+    // Copying from the stream on the gpu doesn't wait for draws still reading the buffer.
+    sf_stream *stream = sf_stream_current();
+    sf_stream_range range;
+    void *packed = stream ? sf_stream_map(stream, size, 4, &range) : nullptr;
+    if (packed) {
+        sf_vertex_pack(layout, packed, vertices, count);
+        sf_stream_unmap(stream);
+        sf_gl_bind_buffer(GL_COPY_READ_BUFFER, range.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, range.offset, offset, range.size);
+        return;
+    }
+
+    if (sf_vertex_layout_native(layout)) {
+        glBufferSubData(target, offset, (GLsizeiptr)size, vertices);
+        return;
+    }
+    packed = sf_malloc(size);
+    sf_vertex_pack(layout, packed, vertices, count);
+    glBufferSubData(target, offset, (GLsizeiptr)size, packed);
+    free(packed);
+}
+
+void sf_vertex_attributes(const sf_vertex_layout *layout, const GLuint vbo) {
+    sf_gl_bind_buffer(GL_ARRAY_BUFFER, vbo);
+    for (GLuint a = 0; a < SF_ATTRIBUTE_COUNT; ++a) {
+        GLenum type;
+        GLboolean normalized = GL_TRUE;
+        switch (layout->formats[a]) {
+            case SF_FORMAT_FLOAT: type = GL_FLOAT; normalized = GL_FALSE; break;
+            case SF_FORMAT_HALF: type = GL_HALF_FLOAT; normalized = GL_FALSE; break;
+            case SF_FORMAT_UNORM8: type = GL_UNSIGNED_BYTE; break;
+            case SF_FORMAT_UNORM16: type = GL_UNSIGNED_SHORT; break;
+            case SF_FORMAT_SNORM16: type = GL_SHORT; break;
+            default:
+                glDisableVertexAttribArray(a);
+                continue;
+        }
+        glEnableVertexAttribArray(a);
+        glVertexAttribPointer(a, sf_attribute_components[a], type, normalized, layout->stride, (void*)(uintptr_t)layout->offsets[a]);
+    }
+}
@@ -26,10 +26,16 @@ void sf_cb_char(GLFWwindow* window, const unsigned int codepoint) {
     }
 }
 
+void sf_cb_cursor(GLFWwindow* window, const double x, const double y) {
+    sf_window *win = glfwGetWindowUserPointer(window);
+    win->mouse_position = (sf_vec2){(float)x, (float)y};
+}
+
 void sf_cb_resize(GLFWwindow* window, const int width, const int height) {
     sf_window *win = glfwGetWindowUserPointer(window);
     win->size = (sf_vec2){(float)width, (float)height};
-    sf_window_set_camera(win, win->camera);
+    // Dragging a window's border sends a size for every step, only the last one before the next frame matters.
+    win->resized = true;
 
     if (glfwGetWindowAttrib(window, GLFW_MAXIMIZED))
         win->hints |= SF_WINDOW_MAXIMIZED;
@@ -42,6 +48,39 @@ void APIENTRY sf_gl_dbglog(GLuint source, GLuint type, GLuint id, GLuint severit
     printf("[OpenGL] (Source %u) (Type %u) (ID %u), (Severity %u) \"%s\"\n", source, type, id, severity, message);
 }
 
+/// Set up the library's state in a window's freshly created context.
+static void sf_window_init_context(sf_window *win, sf_camera *camera) {
+    if (sf_stream_new(&win->stream, SF_STREAM_DEFAULT_SIZE).ok)
+        sf_stream_make_current(&win->stream);
+    win->targets = sf_target_pool_new();
+
+    win->fb_mesh = sf_mesh_new();
+    sf_mesh_add_vertices(&win->fb_mesh, (sf_vertex[]){
+        {{-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
+        {{-1.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
+        {{1.0f, -1.0f, 0.0f}, {0.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
+
+        {{1.0f, 1.0f, 0.0f}, {0.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
+        {{1.0f, -1.0f, 0.0f}, {0.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
+        {{-1.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
+    }, 6);
+    sf_window_set_camera(win, camera);
+
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(sf_gl_dbglog, nullptr);
+    glEnable(GL_DEPTH_TEST);
+}
+
+/// Make a window's context and its state tracker current.
+static void sf_window_make_current(sf_window *window) {
+    if (window->handle)
+        glfwMakeContextCurrent(window->handle);
+    else sf_context_make_current(&window->context);
+    sf_gl_state_make_current(&window->gl);
+    sf_stream_make_current(window->stream.buffer ? &window->stream : nullptr);
+}
+
 sf_result sf_window_new(sf_window **out, const sf_str title, const sf_vec2 size, sf_camera *camera, const uint8_t hints) {
     *out = sf_calloc(1, sizeof(sf_window));
     memcpy(*out, &(sf_window) {
@@ -52,6 +91,16 @@ sf_result sf_window_new(sf_window **out, const sf_str title, const sf_vec2 size,
     }, sizeof(sf_window));
     sf_window *win = *out;
 
+    if ((hints & SF_WINDOW_HEADLESS) == SF_WINDOW_HEADLESS) {
+        sf_gl_state_make_current(&win->gl);
+        const sf_result res = sf_context_new(&win->context, size);
+        if (!res.ok)
+            return res;
+        win->gl.default_framebuffer = win->context.framebuffer;
+        sf_window_init_context(win, camera);
+        return sf_ok();
+    }
+
     //TODO: GLFW Init
     if (!glfwInit()) {
         glfwTerminate();
@@ -73,28 +122,14 @@ sf_result sf_window_new(sf_window **out, const sf_str title, const sf_vec2 size,
     glfwSetErrorCallback(sf_cb_err);
     glfwSetKeyCallback(win->handle, sf_cb_key);
     glfwSetCharCallback(win->handle, sf_cb_char);
+    glfwSetCursorPosCallback(win->handle, sf_cb_cursor);
     glfwSetFramebufferSizeCallback(win->handle, sf_cb_resize);
 
     glfwMakeContextCurrent(win->handle);
+    sf_gl_state_make_current(&win->gl);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
         return sf_err(sf_lit("GLAD Failed to initialize!"));
-    sf_window_set_camera(win, camera);
-
-    win->fb_mesh = sf_mesh_new();
-    sf_mesh_add_vertices(&win->fb_mesh, (sf_vertex[]){
-        {{-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
-        {{-1.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
-        {{1.0f, -1.0f, 0.0f}, {0.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
-
-        {{1.0f, 1.0f, 0.0f}, {0.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
-        {{1.0f, -1.0f, 0.0f}, {0.0f, 1.0f}, sf_rgbagl(SF_WHITE)},
-        {{-1.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, sf_rgbagl(SF_WHITE)},
-    }, 6);
-
-    glEnable(GL_DEBUG_OUTPUT);
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(sf_gl_dbglog, nullptr);
-    glEnable(GL_DEPTH_TEST);
+    sf_window_init_context(win, camera);
 
     if ((hints & SF_WINDOW_VISIBLE) == SF_WINDOW_VISIBLE)
         glfwShowWindow(win->handle);
@@ -113,7 +148,29 @@ sf_result sf_window_new(sf_window **out, const sf_str title, const sf_vec2 size,
 void sf_window_close(sf_window *window) {
     sf_str_free(window->title);
     sf_mesh_delete(&window->fb_mesh);
-    glfwDestroyWindow(window->handle);
+    sf_target_pool_delete(&window->targets);
+    sf_stream_delete(&window->stream);
+    if (window->gl.default_camera) {
+        sf_gl_forget_buffer(window->gl.default_camera);
+        glDeleteBuffers(1, &window->gl.default_camera);
+    }
+    if (!window->handle)
+        sf_context_delete(&window->context);
+    if (sf_gl_state_current() == &window->gl)
+        sf_gl_state_make_current(nullptr);
+    if (window->handle)
+        glfwDestroyWindow(window->handle);
+}
+
+sf_ray sf_window_mouse_ray(const sf_window *window) {
+    // The cursor is in screen coordinates, which only match framebuffer pixels without display scaling.
+    sf_vec2 size = window->size;
+    if (window->handle) {
+        int width, height;
+        glfwGetWindowSize(window->handle, &width, &height);
+        size = (sf_vec2){(float)width, (float)height};
+    }
+    return sf_camera_ray(window->camera, window->mouse_position, size);
 }
 
 sf_str sf_key_string(sf_window *window) {
@@ -123,51 +180,87 @@ sf_str sf_key_string(sf_window *window) {
     return str;
 }
 
+/// Scale the uvs of the quad a camera's image is drawn with, so it only samples the part the camera rendered to.
+static void sf_window_fit_fb_mesh(sf_window *window) {
+    const sf_camera *camera = window->camera;
+    const float u = camera->size.x / camera->fb_color.dimensions.x, v = camera->size.y / camera->fb_color.dimensions.y;
+    sf_vertex *vertices = window->fb_mesh.vertices.data;
+    // Every corner samples one edge of the texture or the other, 0 stays put and 1 becomes the used fraction.
+    for (size_t i = 0; i < window->fb_mesh.vertices.count; ++i)
+        vertices[i].uv = (sf_vec2){vertices[i].uv.x > 0.0f ? u : 0.0f, vertices[i].uv.y > 0.0f ? v : 0.0f};
+    sf_mesh_touch(&window->fb_mesh, 0, window->fb_mesh.vertices.count);
+}
+
 void sf_window_set_camera(sf_window *window, sf_camera *camera) {
     if (camera->type == SF_CAMERA_ORTHOGRAPHIC)
         glm_ortho(0, window->size.x, window->size.y, 0, camera->near, camera->far, camera->projection);
     else glm_perspective(camera->fov, window->size.x/window->size.y, camera->near, camera->far, camera->projection);
 
-    if (camera->framebuffer == 0) {
+    if (camera->framebuffer == 0)
         glGenFramebuffers(1, &camera->framebuffer);
 
-        camera->fb_color = sf_texture_new(SF_TEXTURE_RGBA, window->size);
-        camera->fb_stencil = sf_texture_new(SF_TEXTURE_DEPTH_STENCIL, window->size);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, camera->framebuffer);
+    // The old attachments stay in the pool for a frame, so dragging the window back across a bucket reuses them.
+    const sf_vec2 bucket = sf_target_bucket(window->size);
+    if (camera->targets != &window->targets || camera->fb_color.dimensions.x != bucket.x || camera->fb_color.dimensions.y != bucket.y) {
+        if (camera->targets) {
+            sf_target_release(camera->targets, &camera->fb_color);
+            sf_target_release(camera->targets, &camera->fb_stencil);
+        }
+        camera->targets = &window->targets;
+        camera->fb_color = sf_target_acquire(&window->targets, SF_TEXTURE_RGBA, window->size);
+        camera->fb_stencil = sf_target_acquire(&window->targets, SF_TEXTURE_DEPTH_STENCIL, window->size);
+
+        sf_gl_bind_framebuffer(camera->framebuffer);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, camera->fb_color.handle, 0);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, camera->fb_stencil.handle, 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    } else {
-        sf_texture_resize(&camera->fb_color, window->size);
-        sf_texture_resize(&camera->fb_stencil, window->size);
     }
+    camera->size = window->size;
 
+    sf_camera_update(camera);
     window->camera = camera;
+    sf_window_fit_fb_mesh(window);
 }
 
-bool sf_window_loop(const sf_window *window) {
+bool sf_window_loop(sf_window *window) {
     //TODO: Prepare for frame.
-    glfwMakeContextCurrent(window->handle);
+    sf_window_make_current(window);
     sf_opengl_log();
-    glfwPollEvents();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, window->camera->framebuffer);
-    const sf_glcolor gl = sf_rgbagl(window->camera->clear_color);
+    if (window->handle)
+        glfwPollEvents();
+    if (window->resized) {
+        window->resized = false;
+        sf_window_set_camera(window, window->camera);
+    }
+    // Draws update their camera anyway, this keeps its frustum current for code that culls on its own.
+    sf_camera_update(window->camera);
+
+    // Draw to and clear only the part of the attachments the camera uses.
+    const sf_camera *camera = window->camera;
+    sf_gl_bind_framebuffer(camera->framebuffer);
+    glViewport(0, 0, (GLsizei)camera->size.x, (GLsizei)camera->size.y);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, (GLsizei)camera->size.x, (GLsizei)camera->size.y);
+    const sf_glcolor gl = sf_rgbagl(camera->clear_color);
     glClearColor(gl.r, gl.g, gl.b, gl.a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
 
-    return !glfwWindowShouldClose(window->handle);
+    return !window->handle || !glfwWindowShouldClose(window->handle);
 }
 
 sf_result sf_window_draw(sf_window *window, sf_shader *post_shader) {
-    glfwMakeContextCurrent(window->handle);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    sf_window_make_current(window);
+    sf_gl_bind_framebuffer(0);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glViewport(0, 0, (int)window->size.x, (int)window->size.y);
     const sf_result res = sf_mesh_draw(&window->fb_mesh, post_shader, SF_RENDER_DEFAULT, SF_TRANSFORM_IDENTITY, &window->camera->fb_color);
-    glfwSwapBuffers(window->handle);
+    if (window->handle)
+        glfwSwapBuffers(window->handle);
+    if (window->stream.buffer)
+        sf_stream_end_frame(&window->stream);
+    sf_target_pool_end_frame(&window->targets);
+    sf_gl_state_end_frame();
     if (!res.ok)
         return res;
 
@@ -181,18 +274,40 @@ sf_result sf_window_draw(sf_window *window, sf_shader *post_shader) {
     return sf_ok();
 }
 
+void sf_window_read_pixels(sf_window *window, uint8_t *out) {
+    sf_window_make_current(window);
+    sf_gl_bind_framebuffer(0);
+    // A window's finished frame is in the front buffer once it's been swapped.
+    if (window->handle)
+        glReadBuffer(GL_FRONT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, (GLsizei)window->size.x, (GLsizei)window->size.y, GL_RGBA, GL_UNSIGNED_BYTE, out);
+    if (window->handle)
+        glReadBuffer(GL_BACK);
+}
+
 void sf_window_set_title(sf_window *window, const sf_str title) {
     sf_str_free(window->title);
     window->title = sf_str_dup(title);
-    glfwSetWindowTitle(window->handle, title.c_str);
+    if (window->handle)
+        glfwSetWindowTitle(window->handle, title.c_str);
 }
 
 void sf_window_set_size(sf_window *window, const sf_vec2 size) {
     window->size = size;
-    glfwSetWindowSize(window->handle, (int)size.x, (int)size.y);
+    if (window->handle) {
+        glfwSetWindowSize(window->handle, (int)size.x, (int)size.y);
+        return;
+    }
+    // Headless windows get no resize callback.
+    sf_window_make_current(window);
+    sf_context_resize(&window->context, size);
+    sf_window_set_camera(window, window->camera);
 }
 
 void sf_window_update_hints(sf_window *window, uint8_t hints) {
+    if (!window->handle)
+        return;
     (hints & SF_WINDOW_VISIBLE) == SF_WINDOW_VISIBLE ? glfwShowWindow(window->handle) : glfwHideWindow(window->handle);
 
     if ((hints & SF_WINDOW_MAXIMIZED) == SF_WINDOW_MAXIMIZED)